@@ -21,11 +21,14 @@ void init(arbor::engine::instance& engine) {
         //                                   blah blah blah
         auto plane_id = scene.create_object().value();
 
-        scene.asset_library()[plane_id].model = arbor::assets::model_3d::plane(0.5f, 0.5f);
-        scene.asset_library()[plane_id].material.textures()[arbor::assets::texture::albedo] = {"assets/kitty0.jpg"};
+        arbor::assets::material material;
+        material.textures()[arbor::assets::texture::albedo] = {"assets/kitty0.jpg"};
+
+        scene.asset_library()[plane_id].mesh = scene.asset_library().add_mesh(arbor::assets::model_3d::plane(0.5f, 0.5f));
+        scene.asset_library()[plane_id].material = scene.asset_library().add_material(material);
 
         scene.objects()[plane_id].callbacks().on_update = [](arbor::engine::instance& engine, uint64_t id) {
-            auto& self = engine.current_scene().objects()[id];
+            auto self = engine.current_scene().objects()[id];
             static auto speed = engine.current_scene().control<arbor::scene::controls::slider_f32>("plane movement speed");
 
             static float position = 0.0f;
@@ -41,11 +44,15 @@ void init(arbor::engine::instance& engine) {
         //                                   blah blah blah
         auto cube_id = scene.create_object().value();
 
-        scene.asset_library()[cube_id].model = arbor::assets::model_3d::cube_uv(0.5f, 0.5f, 0.5f);
-        scene.asset_library()[cube_id].material.textures()[arbor::assets::texture::albedo] = {"assets/cube.png"};
+        arbor::assets::material material;
+        material.textures()[arbor::assets::texture::albedo] = {"assets/cube.png"};
+
+        scene.asset_library()[cube_id].mesh = scene.asset_library().add_mesh(arbor::assets::model_3d::cube_uv(0.5f, 0.5f, 0.5f));
+        scene.asset_library()[cube_id].material = scene.asset_library().add_material(material);
 
+        scene.objects()[cube_id].callbacks().thread_safe = true;
         scene.objects()[cube_id].callbacks().on_update = [](arbor::engine::instance& engine, uint64_t id) {
-            auto& self = engine.current_scene().objects()[id];
+            auto self = engine.current_scene().objects().at(id);
             static auto speed = engine.current_scene().control<arbor::scene::controls::slider_f32>("cube rotation speed");
 
             self.transform() = glm::rotate(
@@ -78,6 +85,7 @@ int32_t main(int32_t argc, char** argv) {
 
     app_config.callbacks.on_init = init;
     app_config.callbacks.on_update = update;
+    app_config.parallel_object_updates = true;
 
     if (auto res = engine.run(app_config); !res)
         return -1;
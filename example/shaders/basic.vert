@@ -1,10 +1,17 @@
 #version 460
 
-layout(binding = 0) uniform uniform_buffer {
-    mat4 model;
+layout(set = 0, binding = 0) uniform camera_buffer {
     mat4 view;
     mat4 projection;
-} ubo;
+} camera;
+
+layout(set = 0, binding = 1) readonly buffer transform_buffer {
+    mat4 models[];
+} transforms;
+
+layout(set = 0, binding = 2) readonly buffer visible_buffer {
+    uint instances[];
+} visible;
 
 layout(location = 0) in vec3 vert_position;
 layout(location = 1) in vec3 vert_color;
@@ -14,7 +21,9 @@ layout(location = 0) out vec3 frag_color;
 layout(location = 1) out vec2 frag_texture_coord;
 
 void main() {
-    gl_Position = (ubo.projection * ubo.view * ubo.model) * vec4(vert_position, 1.0);
+    mat4 model = transforms.models[visible.instances[gl_InstanceIndex]];
+
+    gl_Position = (camera.projection * camera.view * model) * vec4(vert_position, 1.0);
     frag_color  = vert_color;
     frag_texture_coord = vert_texture_coord;
 }
\ No newline at end of file
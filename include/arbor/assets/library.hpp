@@ -8,22 +8,40 @@
 
 namespace arbor {
     namespace assets {
+        // handles are derived from the content they refer to, so identical meshes and materials are only stored once
+        using mesh_handle = uint64_t;
+        using material_handle = uint64_t;
+
+        constexpr uint64_t invalid_handle = -1;
+
         class library {
           public:
             struct entry {
-                assets::model_3d model;
-                assets::material material;
+                assets::mesh_handle mesh = assets::invalid_handle;
+                assets::material_handle material = assets::invalid_handle;
             };
 
           private:
             std::unordered_map<uint64_t, library::entry> m_entries;
 
+            std::unordered_map<assets::mesh_handle, assets::model_3d> m_meshes;
+            std::unordered_map<assets::material_handle, assets::material> m_materials;
+
           public:
             constexpr auto& entries() { return m_entries; }
             constexpr auto& entries() const { return m_entries; }
 
             constexpr auto& operator[](uint64_t id) { return m_entries[id]; }
             constexpr auto& at(uint64_t id) const { return m_entries.at(id); }
+
+            assets::mesh_handle add_mesh(const assets::model_3d& model);
+            assets::material_handle add_material(const assets::material& material);
+
+            constexpr auto& meshes() const { return m_meshes; }
+            constexpr auto& materials() const { return m_materials; }
+
+            constexpr auto& mesh(assets::mesh_handle handle) const { return m_meshes.at(handle); }
+            constexpr auto& material(assets::material_handle handle) const { return m_materials.at(handle); }
         };
     } // namespace assets
 } // namespace arbor
\ No newline at end of file
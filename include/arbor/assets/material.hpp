@@ -1,5 +1,6 @@
 #pragma once
 
+#include <filesystem>
 #include <unordered_map>
 
 #include "arbor/assets/texture.hpp"
@@ -9,10 +10,23 @@ namespace arbor {
         class material {
             std::unordered_map<assets::texture::etype, assets::texture> m_textures;
 
+            // empty paths are filled in with the scene's shaders
+            std::filesystem::path m_vertex_shader;
+            std::filesystem::path m_fragment_shader;
+
           public:
             constexpr auto& textures() { return m_textures; }
             constexpr auto& textures() const { return m_textures; }
 
+            void vertex_shader(const std::filesystem::path& src) { m_vertex_shader = src; }
+            void fragment_shader(const std::filesystem::path& src) { m_fragment_shader = src; }
+
+            constexpr auto& vertex_shader() const { return m_vertex_shader; }
+            constexpr auto& fragment_shader() const { return m_fragment_shader; }
+
+            uint64_t hash() const;
+            bool operator==(const material& other) const;
+
             static material make_default();
         };
     } // namespace assets
@@ -18,10 +18,26 @@ namespace arbor {
             static std::pair<VkVertexInputBindingDescription, std::array<VkVertexInputAttributeDescription, 3>> make_vk_binding();
         };
 
+        struct bounds_3d {
+            glm::vec3 min{0.0f};
+            glm::vec3 max{0.0f};
+
+            // xyz is the center and w the radius
+            glm::vec4 sphere{0.0f};
+        };
+
         struct model_3d {
             std::vector<vertex_3d> vertices;
             std::vector<uint32_t> indices;
 
+            // derived from the vertices, kept up to date by update_bounds()
+            bounds_3d bounds;
+
+            void update_bounds();
+
+            uint64_t hash() const;
+            bool operator==(const model_3d& other) const;
+
             static model_3d cube(float32_t scale_x = 1.0f, float32_t scale_y = 1.0f, float32_t scale_z = 1.0f);
             static model_3d cube_uv(float32_t scale_x = 1.0f, float32_t scale_y = 1.0f, float32_t scale_z = 1.0f);
 
@@ -3,6 +3,7 @@
 #include <expected>
 #include <filesystem>
 #include <optional>
+#include <span>
 #include <vector>
 
 #include "arbor/types.hpp"
@@ -20,11 +21,29 @@ namespace arbor {
                 albedo = 0,
             };
 
+            // decoded images are rgba8, the others are 4x4 block compressed and come from .ktx2 or .dds containers.
+            // srgb variants are read as their unorm counterparts, like decoded images
+            enum class eformat {
+                rgba8,
+                bc1,
+                bc3,
+                bc7,
+            };
+
+            // where a level lives in data(), compressed containers carry their mip chain along
+            struct mip_level {
+                uint64_t offset = 0, size = 0;
+                int32_t width = 0, height = 0;
+            };
+
           private:
             etype m_type;
+            eformat m_format = eformat::rgba8;
 
             int32_t m_width, m_height;
             std::vector<pixel_rgba> m_pixels;
+            std::vector<uint8_t> m_blocks;
+            std::vector<texture::mip_level> m_levels;
 
             std::optional<std::filesystem::path> m_source;
 
@@ -32,13 +51,35 @@ namespace arbor {
             texture(etype type = texture::etype::albedo) : m_source(), m_type(type) {}
             texture(const std::filesystem::path& source, etype type = texture::etype::albedo) : m_source(source), m_type(type) {}
 
-            std::expected<void, std::string> load();
+            // `supported` are the compressed formats the caller can use. a .ktx2 or .dds next to the source that's at least
+            // as new as it is loaded instead of decoding the source if it's in one of them
+            std::expected<void, std::string> load(std::span<const texture::eformat> supported = {});
             std::expected<void, std::string> load(int32_t width, int32_t height, const texture::pixel_rgba& color = {0, 0, 0, 0});
 
             constexpr auto type() const { return m_type; }
+            constexpr auto format() const { return m_format; }
             constexpr auto width() const { return m_width; }
             constexpr auto height() const { return m_height; }
             constexpr auto& pixels() const { return m_pixels; }
+            constexpr auto& levels() const { return m_levels; }
+            constexpr auto& source() const { return m_source; }
+
+            std::span<const uint8_t> data() const {
+                if (m_format == eformat::rgba8)
+                    return {reinterpret_cast<const uint8_t*>(m_pixels.data()), m_pixels.size() * sizeof(pixel_rgba)};
+
+                return m_blocks;
+            }
+
+            static constexpr uint64_t block_size(eformat format) { return format == eformat::bc1 ? 8 : 16; }
+
+            // bytes of one level, formats are either rgba8 or made of 4x4 blocks
+            static constexpr uint64_t level_size(eformat format, int32_t width, int32_t height) {
+                if (format == eformat::rgba8)
+                    return static_cast<uint64_t>(width) * height * sizeof(pixel_rgba);
+
+                return static_cast<uint64_t>((width + 3) / 4) * ((height + 3) / 4) * block_size(format);
+            }
         };
     } // namespace assets
 } // namespace arbor
\ No newline at end of file
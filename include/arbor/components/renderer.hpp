@@ -1,15 +1,24 @@
 #pragma once
+#include <array>
+#include <deque>
 #include <expected>
 #include <filesystem>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <span>
 #include <string>
 #include <unordered_map>
 #include <vector>
 #include <vulkan/vulkan_core.h>
 
+#include "arbor/assets/library.hpp"
 #include "arbor/assets/model.hpp"
 #include "arbor/assets/texture.hpp"
 #include "arbor/components/component.hpp"
 #include "arbor/engine.hpp"
+#include "arbor/file_watcher.hpp"
 #include "arbor/types.hpp"
 #include "arbor/window.hpp"
 
@@ -23,13 +32,82 @@ namespace arbor {
             struct device_queue_family_indices {
                 uint32_t graphics_family;
                 uint32_t present_family;
+
+                // a family that can't do graphics if the device has one, uploads don't compete with the frames on it.
+                // the graphics family otherwise
+                uint32_t transfer_family;
             };
 
-            struct mvp {
-                glm::mat4 model;
+            // written once per frame, the per-object model matrices are streamed separately
+            struct camera_data {
                 glm::mat4 view;
                 glm::mat4 projection;
             };
+
+            // drawable objects sharing a mesh and a material, drawn with a single instanced call
+            struct draw_batch {
+                uint32_t index_count = 0;
+                uint32_t first_index = 0;
+                int32_t vertex_offset = 0;
+
+                uint32_t first_instance = 0;
+                uint32_t instance_count = 0;
+
+                assets::mesh_handle mesh = assets::invalid_handle;
+                assets::material_handle material = assets::invalid_handle;
+
+                // index into the pipeline's material descriptor sets
+                uint32_t material_set = 0;
+
+                // the pipeline variant the batch's material is drawn with
+                uint32_t pipeline = 0;
+                uint64_t sort_key = 0;
+
+                // object space bounding sphere of the mesh, xyz is the center and w the radius
+                glm::vec4 bounds{0.0f};
+            };
+
+            // per batch data read by the culling stage, laid out to match the std430 struct in the cull shader
+            struct cull_batch {
+                glm::vec4 bounds;
+
+                uint32_t first_instance;
+                uint32_t material_set;
+                uint32_t first_draw;
+                uint32_t padding;
+            };
+
+            // batches are drawn in the order of their keys, grouped by pipeline first, then by material and then by mesh,
+            // so every one of them is bound once per run
+            constexpr uint64_t draw_sort_key(uint32_t pipeline, uint32_t material_set, uint32_t mesh) {
+                return uint64_t(pipeline & 0xffff) << 48 | uint64_t(material_set & 0xffffff) << 24 | (mesh & 0xffffff);
+            }
+
+            // indices of the keys in ascending key order, ties keep their original order. an LSD radix sort over
+            // 8-bit digits that skips the digits every key shares, which with packed sort keys is most of the high ones
+            std::vector<uint32_t> radix_sort(std::span<const uint64_t> keys);
+
+            // state bound to a secondary command buffer while draws are recorded into it, binds that wouldn't change
+            // anything are dropped. binds_per_packet is what a draw packet recorded on its own would bind (a pipeline,
+            // its material set and both buffers), only a reference point for the statistics
+            struct bind_state {
+                VkPipeline pipeline = VK_NULL_HANDLE;
+                VkDescriptorSet material_set = VK_NULL_HANDLE;
+                VkBuffer vertex_buffer = VK_NULL_HANDLE;
+                VkBuffer index_buffer = VK_NULL_HANDLE;
+
+                uint32_t packets = 0;
+                uint32_t binds = 0;
+
+                void bind_pipeline(VkCommandBuffer command_buffer, VkPipeline handle);
+                void bind_material_set(VkCommandBuffer command_buffer, VkPipelineLayout layout, VkDescriptorSet set);
+                void bind_geometry(VkCommandBuffer command_buffer, VkBuffer vertices, VkBuffer indices);
+
+                constexpr static uint32_t binds_per_packet = 4;
+            };
+
+            // normalized planes (left, right, bottom, top, near, far) bounding the clip volume of a view projection matrix
+            std::array<glm::vec4, 6> frustum_planes(const glm::mat4& view_projection);
         } // namespace detail
 
         class instance;
@@ -46,12 +124,16 @@ namespace arbor {
                     invalid = -1,
                     vertex = 0,
                     fragment = 1,
+                    compute = 2,
                 };
 
               private:
                 std::filesystem::path m_source;
                 shader::etype m_type = etype::invalid;
 
+                // set for shaders the engine builds from sources it ships itself, m_source is only used as a name then
+                bool m_embedded = false;
+
                 std::string m_glsl;
                 std::vector<uint32_t> m_spv;
 
@@ -65,8 +147,8 @@ namespace arbor {
                     : m_source(glsl_source), m_type(type), m_vk_device(device) {}
 
                 shader(shader&& other)
-                    : m_source(std::move(other.m_source)), m_type(other.m_type), m_vk_device(other.m_vk_device),
-                      m_vk_shader(other.m_vk_shader) {
+                    : m_source(std::move(other.m_source)), m_type(other.m_type), m_embedded(other.m_embedded),
+                      m_glsl(std::move(other.m_glsl)), m_vk_device(other.m_vk_device), m_vk_shader(other.m_vk_shader) {
                     other.m_type = etype::invalid;
                     other.m_vk_device = VK_NULL_HANDLE;
                     other.m_vk_shader = VK_NULL_HANDLE;
@@ -77,6 +159,8 @@ namespace arbor {
                 auto& operator=(shader&& other) {
                     m_source.swap(other.m_source);
                     m_type = other.m_type;
+                    m_embedded = other.m_embedded;
+                    m_glsl.swap(other.m_glsl);
                     m_vk_device = other.m_vk_device;
 
                     other.m_source.clear();
@@ -87,7 +171,11 @@ namespace arbor {
                     return *this;
                 }
 
-                std::expected<void, std::string> compile();
+                static shader from_glsl(const std::string& name, std::string glsl, shader::etype type, VkDevice device);
+
+                // an empty cache directory always compiles, otherwise SPIR-V is looked up by a hash of everything
+                // that goes into compiling it first
+                std::expected<void, std::string> compile(const std::filesystem::path& cache_directory = {});
 
                 VkShaderStageFlagBits stage() const;
                 auto source() const { return m_source; }
@@ -99,116 +187,429 @@ namespace arbor {
                 constexpr auto spv() const { return m_spv; }
             };
 
+            // the render pass, layout and descriptor sets every draw shares, along with a VkPipeline for every set of
+            // shaders the scene's materials use. those are built lazily and cached by a hash of their shader sources
             class pipeline {
                 friend class renderer;
+
+              public:
+                using shader_sources = std::map<shader::etype, std::filesystem::path>;
+
+              private:
                 engine::renderer& m_renderer;
 
+                // what a VkPipeline has to agree on with the render pass it's used in
+                struct target {
+                    VkFormat color_format = VK_FORMAT_UNDEFINED;
+                    VkFormat depth_format = VK_FORMAT_UNDEFINED;
+                    VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT;
+
+                    bool operator==(const target& other) const = default;
+                };
+
+                // a pipeline compiled and linked on a worker thread. it only holds handles that stay alive until the
+                // job is done, so the pipeline can be reloaded again while it's running
+                struct build {
+                    uint32_t variant = 0;
+                    uint64_t generation = 0;
+                    pipeline::target target;
+
+                    VkDevice device = VK_NULL_HANDLE;
+                    VkPipelineCache pipeline_cache = VK_NULL_HANDLE;
+                    VkRenderPass render_pass = VK_NULL_HANDLE;
+                    VkPipelineLayout layout = VK_NULL_HANDLE;
+                    bool sample_shading = false;
+
+                    std::filesystem::path shader_cache_path;
+                    std::vector<renderer::shader> shaders;
+
+                    VkPipeline pipeline = VK_NULL_HANDLE;
+                    std::string error;
+
+                    job_system::handle job;
+                };
+
+                // a VkPipeline is used with the current render pass for as long as its target matches and swapped for
+                // the newest finished build of the same shaders between frames
+                struct variant {
+                    pipeline::shader_sources sources;
+
+                    VkPipeline handle = VK_NULL_HANDLE;
+                    pipeline::target target;
+                    uint64_t generation = 0;
+                };
+
                 VkPipelineLayoutCreateInfo m_pipeline_layout_create_info{};
-                VkPipelineColorBlendAttachmentState m_color_blend_attachment{};
-                VkPipelineDynamicStateCreateInfo m_dynamic_state{};
-                VkPipelineViewportStateCreateInfo m_viewport_state{};
-                VkPipelineRasterizationStateCreateInfo m_rasterizer_state{};
-                VkPipelineVertexInputStateCreateInfo m_vertex_input_state{};
-                VkPipelineMultisampleStateCreateInfo m_multisampler_state{};
-                VkPipelineColorBlendStateCreateInfo m_color_blend_state{};
-                VkPipelineInputAssemblyStateCreateInfo m_input_assembly_state{};
 
                 VkRect2D m_scissor{};
                 VkViewport m_viewport{};
 
-                VkPipeline m_pipeline = VK_NULL_HANDLE;
                 VkRenderPass m_render_pass = VK_NULL_HANDLE;
                 VkPipelineLayout m_pipeline_layout = VK_NULL_HANDLE;
 
-                std::vector<VkDescriptorSet> m_descriptor_sets;
                 VkDescriptorPool m_descriptor_pool = VK_NULL_HANDLE;
-                VkDescriptorSetLayout m_descriptor_set_layout = VK_NULL_HANDLE;
 
-                std::vector<VkDynamicState> m_dynamic_states = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
-                std::vector<VkPipelineShaderStageCreateInfo> m_pipeline_stages;
+                VkDescriptorSet m_frame_descriptor_set = VK_NULL_HANDLE;
+                VkDescriptorSetLayout m_frame_set_layout = VK_NULL_HANDLE;
 
-                std::unordered_map<shader::etype, engine::renderer::shader> m_shaders;
+                std::vector<VkDescriptorSet> m_material_descriptor_sets;
+                VkDescriptorSetLayout m_material_set_layout = VK_NULL_HANDLE;
+
+                // variants are never removed, their indices are what draw batches and sort keys refer to
+                std::vector<pipeline::variant> m_variants;
+                std::unordered_map<uint64_t, uint32_t> m_variant_indices;
+
+                pipeline::target m_target;
+
+                uint64_t m_generation = 0;
+                std::vector<std::shared_ptr<pipeline::build>> m_builds;
 
               public:
                 ~pipeline();
                 pipeline(engine::renderer& parent) : m_renderer(parent) {}
-                pipeline(pipeline&& other) : m_renderer(other.m_renderer), m_shaders(std::move(other.m_shaders)) {}
+                pipeline(pipeline&& other) : m_renderer(other.m_renderer), m_variant_indices(std::move(other.m_variant_indices)) {
+                    for (auto& variant : other.m_variants)
+                        m_variants.push_back({.sources = std::move(variant.sources)});
+                }
 
                 pipeline(const pipeline&) = delete;
 
-                std::expected<void, std::string> reload(bool rebuild = true);
-                std::expected<void, std::string> bind_shader(const std::filesystem::path& glsl_source, shader::etype type);
+                std::expected<void, std::string> reload(bool rebuild_pipeline = true);
+
+                // index of the variant built from the given shaders, new ones start building as soon as there's a
+                // render pass to build them against
+                uint32_t variant_index(const pipeline::shader_sources& sources);
+
+                // recompiles a variant's shaders and links a new pipeline in the background
+                void rebuild(uint32_t variant);
+                // installs the newest finished builds, only fails if a variant has no pipeline to fall back on
+                std::expected<void, std::string> poll_builds();
+
+                constexpr auto variant_count() const { return static_cast<uint32_t>(m_variants.size()); }
+                bool uses_shader(uint32_t variant, const std::filesystem::path& glsl_source) const;
+
+                // false until the variant is built for the current render pass, nothing is drawn with it until then
+                bool ready(uint32_t variant) const {
+                    return variant < m_variants.size() && m_variants[variant].handle && m_variants[variant].target == m_target;
+                }
 
               protected:
                 constexpr auto scissors() const { return &m_scissor; }
                 constexpr auto viewports() const { return &m_viewport; }
                 constexpr auto render_pass() const { return m_render_pass; }
                 constexpr auto descriptor_pool() const { return m_descriptor_pool; }
-                constexpr auto pipeline_handle() const { return m_pipeline; }
+                constexpr auto pipeline_handle(uint32_t variant) const { return m_variants[variant].handle; }
 
               private:
                 std::expected<void, std::string> make_vk_descriptor_pool_and_sets();
+                void wait_for_builds();
+
+                static void compile_and_link(pipeline::build& build);
             };
 
-            class device_buffer {
+            class device_allocator {
+              public:
+                // buffers and optimally tiled images never share a block, so bufferImageGranularity never has to be honoured
+                enum ekind {
+                    linear = 0,
+                    optimal = 1,
+                };
+
+                struct allocation {
+                    VkDeviceMemory memory = VK_NULL_HANDLE;
+                    uint64_t offset = 0;
+                    uint64_t size = 0;
+                    void* mapped = nullptr;
+
+                    uint32_t pool = uint32_t(-1);
+                };
+
+                struct heap_statistics {
+                    VkMemoryHeapFlags flags = 0;
+                    uint64_t heap_size = 0;
+
+                    uint64_t block_count = 0;
+                    uint64_t allocation_count = 0;
+                    uint64_t bytes_reserved = 0;
+                    uint64_t bytes_used = 0;
+                };
+
+              private:
+                struct block {
+                    VkDeviceMemory memory = VK_NULL_HANDLE;
+                    uint64_t size = 0;
+                    void* mapped = nullptr;
+
+                    bool dedicated = false;
+                    uint64_t allocations = 0;
+                    uint64_t bytes_used = 0;
+
+                    // offset -> size of every free range, kept coalesced
+                    std::map<uint64_t, uint64_t> free_ranges;
+                };
+
                 VkDevice m_device = VK_NULL_HANDLE;
                 VkPhysicalDevice m_physical_device = VK_NULL_HANDLE;
+                VkPhysicalDeviceMemoryProperties m_memory_properties{};
+
+                std::shared_ptr<spdlog::logger> m_logger;
+
+                uint64_t m_block_size = 64ull << 20;
+
+                std::mutex m_mutex;
+                std::array<std::vector<std::unique_ptr<block>>, VK_MAX_MEMORY_TYPES * 2> m_pools;
+
+              public:
+                ~device_allocator();
+                device_allocator() = default;
+
+                device_allocator(device_allocator&&) = delete;
+                device_allocator(const device_allocator&) = delete;
+
+                void init(VkDevice device, VkPhysicalDevice physical_device, std::shared_ptr<spdlog::logger> logger);
+                void destroy();
+
+                std::expected<allocation, std::string> allocate(const VkMemoryRequirements& requirements,
+                                                                VkMemoryPropertyFlags properties, device_allocator::ekind kind);
+                std::expected<allocation, std::string> allocate(VkBuffer buffer, VkMemoryPropertyFlags properties);
+                std::expected<allocation, std::string> allocate(VkImage image, VkMemoryPropertyFlags properties);
+
+                void free(allocation& memory);
+
+                std::vector<heap_statistics> statistics();
+
+                constexpr auto device() const { return m_device; }
+                constexpr auto physical_device() const { return m_physical_device; }
+
+              private:
+                std::expected<uint32_t, std::string> find_memory_type(uint32_t type_bits, VkMemoryPropertyFlags properties) const;
+                std::expected<device_allocator::block*, std::string> make_block(uint32_t pool, uint64_t size, uint64_t min_size,
+                                                                                bool dedicated);
+                void free_block(uint32_t pool, device_allocator::block* block);
+            };
+
+            class device_buffer {
+                renderer::device_allocator* m_allocator = nullptr;
 
                 VkBuffer m_buffer = VK_NULL_HANDLE;
-                VkDeviceMemory m_memory = VK_NULL_HANDLE;
+                renderer::device_allocator::allocation m_allocation;
 
                 VkBufferUsageFlags m_usage = 0;
 
                 uint64_t m_size = 0;
-                bool m_keep_mapped = false;
-                void* m_mapped = nullptr;
 
               public:
                 ~device_buffer();
+                // a buffer used by more than one queue family is shared between them, no ownership transfers needed
                 std::expected<void, std::string> make(uint64_t size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties,
-                                                      VkDevice device, VkPhysicalDevice physical_device,
-                                                      bool keep_mapped = false);
+                                                      renderer::device_allocator& allocator,
+                                                      std::span<const uint32_t> queue_families = {});
 
-                std::expected<void, std::string> write_data(const void* bytes, uint64_t size,
-                                                            VkQueue transfer_queue = VK_NULL_HANDLE,
-                                                            VkCommandPool command_pool = VK_NULL_HANDLE);
+                // only for host visible memory, device local buffers are written through the upload queue
+                std::expected<void, std::string> write_data(const void* bytes, uint64_t size);
 
                 void free();
+                // detaches the buffer and its memory, they're destroyed once the returned function is called.
+                // lets a replaced buffer outlive the frames in flight that still read from it
+                std::function<void()> release();
 
                 constexpr auto size() const { return m_size; }
+                constexpr auto mapped() const { return m_allocation.mapped; }
                 constexpr auto buffer() { return &m_buffer; }
                 constexpr auto buffer() const { return &m_buffer; }
-                constexpr auto memory() { return &m_memory; }
-                constexpr auto memory() const { return &m_memory; }
+                constexpr auto& allocation() const { return m_allocation; }
             };
 
             class texture {
-                VkDevice m_device;
-                VkPhysicalDevice m_physical_device;
+                VkDevice m_device = VK_NULL_HANDLE;
+                renderer::device_allocator* m_allocator = nullptr;
 
-                renderer::device_buffer m_staging_buffer;
                 uint32_t m_width = 0, m_height = 0;
+                uint32_t m_mip_levels = 1;
 
                 VkImage m_image = VK_NULL_HANDLE;
                 VkImageView m_image_view = VK_NULL_HANDLE;
-                VkDeviceMemory m_image_memory = VK_NULL_HANDLE;
+                renderer::device_allocator::allocation m_image_memory;
                 VkSampler m_sampler = VK_NULL_HANDLE;
 
               public:
                 ~texture();
                 texture() = default;
-                texture(VkDevice device, VkPhysicalDevice physical_device)
-                    : m_device(device), m_physical_device(physical_device) {}
+                texture(renderer::device_allocator& allocator) : m_device(allocator.device()), m_allocator(&allocator) {}
 
                 void destroy();
 
                 std::expected<void, std::string> load(const assets::texture& source, engine::renderer& renderer);
 
                 constexpr auto image() { return m_image; }
+                constexpr auto mip_levels() const { return m_mip_levels; }
                 constexpr auto sampler() { return m_sampler; }
                 constexpr auto image_view() { return m_image_view; }
             };
 
+            // copies into device local memory are recorded into one command buffer and submitted together on the transfer
+            // queue, each submission signals the next value of a timeline semaphore. frames wait on the last value
+            // submitted before them. the data is staged in a persistently mapped ring, a batch's region of it is reused
+            // once the batch's value is reached. when the ring is full, staging waits on the oldest batch in flight
+            class upload_queue {
+                friend class renderer;
+                engine::renderer& m_renderer;
+
+                // satisfies the copy offset alignment of every format, block compressed ones included
+                constexpr static uint64_t staging_alignment = 16;
+
+                // an image whose base level was uploaded, the rest of its levels are blitted from it on the graphics queue
+                struct mip_chain {
+                    VkImage image = VK_NULL_HANDLE;
+                    uint32_t width = 0, height = 0;
+                    uint32_t levels = 1;
+                };
+
+                struct batch {
+                    VkCommandBuffer command_buffer = VK_NULL_HANDLE;
+                    uint64_t value = 0;
+                    uint32_t n_copies = 0;
+                    std::vector<upload_queue::mip_chain> mip_chains;
+
+                    // where the batch's region of the ring ends, uploads larger than the ring get a buffer of their own
+                    uint64_t ring_end = 0;
+                    std::vector<std::unique_ptr<renderer::device_buffer>> oversized;
+                };
+
+                VkQueue m_queue = VK_NULL_HANDLE;
+                VkCommandPool m_command_pool = VK_NULL_HANDLE;
+                VkSemaphore m_timeline = VK_NULL_HANDLE;
+
+                // the families resources written by uploads are shared between, just one if it's the graphics family
+                std::array<uint32_t, 2> m_families{};
+                uint32_t m_n_families = 0;
+
+                // head and tail grow monotonically, offsets into the ring are taken modulo its size
+                renderer::device_buffer m_ring;
+                uint64_t m_ring_head = 0;
+                uint64_t m_ring_tail = 0;
+
+                batch m_recording;
+                std::deque<batch> m_in_flight;
+                std::vector<VkCommandBuffer> m_free_command_buffers;
+
+                // chains of submitted batches, recorded into the next frame since it waits on them anyway
+                std::vector<upload_queue::mip_chain> m_mip_chains;
+
+                // destructors paired with the value that has to be reached before they run
+                std::deque<std::pair<uint64_t, std::function<void()>>> m_releases;
+
+                uint64_t m_submitted = 0;
+                uint64_t m_awaited = 0;
+
+              public:
+                ~upload_queue();
+                upload_queue(engine::renderer& parent) : m_renderer(parent) {}
+
+                upload_queue(upload_queue&&) = delete;
+                upload_queue(const upload_queue&) = delete;
+
+                std::expected<void, std::string> init();
+                void destroy();
+
+                std::expected<void, std::string> copy_to_buffer(const void* bytes, uint64_t size, VkBuffer destination,
+                                                                uint64_t offset);
+                std::expected<void, std::string> copy_buffer(VkBuffer source, VkBuffer destination, const VkBufferCopy& region);
+
+                // uploads either every level or just the base one, the regions' buffer offsets are relative to `bytes`.
+                // the image ends up in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, when only the base level was uploaded
+                // once the frame that records the rest of the chain has run
+                std::expected<void, std::string> copy_to_image(const void* bytes, uint64_t size, VkImage image,
+                                                               std::span<const VkBufferImageCopy> regions,
+                                                               uint32_t mip_levels = 1);
+
+                // blits the levels of every image uploaded in the batches submitted so far. transfer queues can't blit,
+                // so it's recorded into a frame's command buffer
+                void record_mip_chains(VkCommandBuffer command_buffer);
+
+                // submits everything recorded since the last flush, a no-op if nothing was
+                std::expected<void, std::string> flush();
+
+                // runs `destroy` once every upload recorded so far has completed, for resources they read from
+                void release(std::function<void()> destroy);
+
+                // recycles the ring regions and command buffers of completed batches
+                void collect();
+
+                // the value a frame has to wait on before it reads anything uploaded so far, 0 once a frame already has
+                uint64_t take_wait_value();
+
+                constexpr auto timeline() const { return m_timeline; }
+                std::span<const uint32_t> queue_families() const { return {m_families.data(), m_n_families}; }
+
+              private:
+                std::expected<VkCommandBuffer, std::string> recording_command_buffer();
+                // copies the bytes into the ring, returns the buffer and offset to copy from
+                std::expected<std::pair<VkBuffer, uint64_t>, std::string> stage(const void* bytes, uint64_t size);
+                std::expected<uint64_t, std::string> allocate_staging(uint64_t size);
+                void wait(uint64_t value);
+            };
+
+            // compute stage recorded ahead of the render pass. every instance is tested against the camera frustum and a
+            // depth pyramid built from the previous frame's depth buffer, the survivors are written to the visible instance
+            // list of the frame ring and their batches are compacted into the indirect buffer
+            class cull_pass {
+                friend class renderer;
+                engine::renderer& m_renderer;
+
+                VkPipelineLayout m_cull_layout = VK_NULL_HANDLE;
+                VkPipeline m_cull_pipeline = VK_NULL_HANDLE;
+                VkDescriptorSetLayout m_cull_set_layout = VK_NULL_HANDLE;
+                VkDescriptorPool m_cull_descriptor_pool = VK_NULL_HANDLE;
+                std::vector<VkDescriptorSet> m_cull_descriptor_sets;
+
+                VkPipelineLayout m_reduce_layout = VK_NULL_HANDLE;
+                VkPipeline m_depth_reduce_pipeline = VK_NULL_HANDLE;
+                VkPipeline m_pyramid_reduce_pipeline = VK_NULL_HANDLE;
+                VkDescriptorSetLayout m_reduce_set_layout = VK_NULL_HANDLE;
+                VkDescriptorPool m_reduce_descriptor_pool = VK_NULL_HANDLE;
+                std::vector<VkDescriptorSet> m_reduce_descriptor_sets;
+
+                VkImage m_pyramid = VK_NULL_HANDLE;
+                VkImageView m_pyramid_view = VK_NULL_HANDLE;
+                std::vector<VkImageView> m_pyramid_level_views;
+                renderer::device_allocator::allocation m_pyramid_memory;
+                VkSampler m_pyramid_sampler = VK_NULL_HANDLE;
+
+                uint32_t m_pyramid_width = 0, m_pyramid_height = 0;
+                uint32_t m_pyramid_levels = 0;
+
+                renderer::device_buffer m_batches;
+                renderer::device_buffer m_instance_batches;
+
+                renderer::device_buffer m_parameters;
+                uint64_t m_parameters_frame_size = 0;
+
+                glm::mat4 m_previous_view_projection{1.0f};
+
+                // the depth buffer only holds something worth testing against once a frame has been rendered into it
+                bool m_depth_valid = false;
+
+              public:
+                ~cull_pass();
+                cull_pass(engine::renderer& parent) : m_renderer(parent) {}
+
+                cull_pass(cull_pass&&) = delete;
+                cull_pass(const cull_pass&) = delete;
+
+                void destroy();
+
+                std::expected<void, std::string> make_pipelines();
+                std::expected<void, std::string> make_pyramid();
+                std::expected<void, std::string> make_descriptor_sets();
+
+                std::expected<void, std::string> record(VkCommandBuffer command_buffer);
+
+              private:
+                void destroy_pyramid();
+                void write_pyramid_descriptors();
+            };
+
           private:
             engine::instance& m_engine;
 
@@ -237,12 +638,12 @@ namespace arbor {
                     std::vector<VkFramebuffer> framebuffers;
 
                     VkImage depth_image;
-                    VkDeviceMemory depth_buffer;
+                    renderer::device_allocator::allocation depth_buffer;
                     VkImageView depth_image_view;
 
                     VkImage msaa_image;
                     VkImageView msaa_image_view;
-                    VkDeviceMemory msaa_image_buffer;
+                    renderer::device_allocator::allocation msaa_image_buffer;
 
                     VkExtent2D extent;
                     VkSurfaceFormatKHR format;
@@ -254,14 +655,52 @@ namespace arbor {
                 VkDevice device = VK_NULL_HANDLE;
                 VkQueue graphics_queue = VK_NULL_HANDLE;
                 VkQueue present_queue = VK_NULL_HANDLE;
+                VkQueue transfer_queue = VK_NULL_HANDLE;
+
+                renderer::device_allocator allocator;
+
+                // compiled pipelines survive between runs, the file is only trusted if it was made on this device and driver
+                VkPipelineCache pipeline_cache = VK_NULL_HANDLE;
+                std::filesystem::path pipeline_cache_path = "arbor_pipeline_cache.bin";
+                std::filesystem::path shader_cache_path = "arbor_shader_cache";
 
                 VkCommandPool command_pool = VK_NULL_HANDLE;
                 std::vector<VkCommandBuffer> command_buffers;
                 std::vector<VkCommandBuffer> temporary_command_buffers;
 
+                // the render pass is recorded into secondary command buffers on the engine's job system. every chunk of
+                // draws has a pool per frame in flight, indexed [frame * n_threads + chunk], with one draw buffer
+                // allocated from it. the gui gets its own buffer from the first chunk's pool
+                struct {
+                    uint32_t n_threads = 1;
+                    uint32_t min_batches_per_thread = 64;
+
+                    std::vector<VkCommandPool> pools;
+                    std::vector<VkCommandBuffer> draw_buffers;
+                    std::vector<VkCommandBuffer> gui_buffers;
+                } recording;
+
+                // meshes are appended behind the ones already uploaded, both buffers grow geometrically when they're full
                 renderer::device_buffer index_buffer;
                 renderer::device_buffer vertex_buffer;
-                std::vector<renderer::device_buffer> uniform_buffers;
+
+                // one persistently mapped buffer holding a region per frame in flight, each region is the camera block
+                // followed by one model matrix per drawable object and the transform slots of the visible instances.
+                // regions have room for frame_ring_capacity objects, so objects can be added without reallocating
+                renderer::device_buffer frame_ring;
+                uint64_t frame_ring_capacity = 0;
+                uint64_t frame_ring_camera_size = 0;
+                uint64_t frame_ring_transforms_size = 0;
+                uint64_t frame_ring_frame_size = 0;
+
+                // one VkDrawIndexedIndirectCommand per draw batch, again with a region per frame in flight.
+                // with gpu culling every region also holds the compacted commands and a draw count per material
+                renderer::device_buffer indirect_buffer;
+                uint64_t indirect_batch_capacity = 0;
+                uint64_t indirect_material_capacity = 0;
+                uint64_t indirect_frame_size = 0;
+                uint64_t indirect_compacted_offset = 0;
+                uint64_t indirect_counts_offset = 0;
 
                 struct {
                     const uint32_t frames_in_flight = 3;
@@ -277,6 +716,29 @@ namespace arbor {
                 struct {
                     VkPresentModeKHR present_mode = VK_PRESENT_MODE_MAILBOX_KHR;
                     VkSampleCountFlagBits sample_count = VK_SAMPLE_COUNT_8_BIT;
+
+                    // indirect draws need a non-zero firstInstance, otherwise batches are drawn one direct call each
+                    bool indirect_draws = true;
+
+                    // culling fills the indirect buffer, so it's only available along with indirect draws.
+                    // occlusion needs a sampleable multisampled depth buffer, compaction needs drawIndirectCount.
+                    // occlusion_culling is what's in effect for the current sample count, the request is kept for when
+                    // a later sample count supports it again
+                    bool gpu_culling = true;
+                    bool occlusion_culling_requested = true;
+                    bool occlusion_culling = true;
+                    bool indirect_count = false;
+
+                    // rebuilds the pipelines whose shader sources were written to while running. off in release builds,
+                    // the watcher is polled every frame
+#ifdef NDEBUG
+                    bool shader_hot_reload = false;
+#else
+                    bool shader_hot_reload = true;
+#endif
+
+                    // host visible memory every upload is staged through
+                    uint64_t staging_ring_size = 64ull << 20;
                 } config;
 
                 std::atomic<bool> deferred_scene_reload = false;
@@ -287,13 +749,57 @@ namespace arbor {
             } vk;
 
             std::vector<renderer::pipeline> m_pipelines;
+            engine::file_watcher m_shader_watcher;
+            renderer::cull_pass m_culling{*this};
+            renderer::upload_queue m_uploads{*this};
+
+            glm::mat4 m_view_projection{1.0f};
+
+            // batches are sorted by material, the instances of a batch occupy consecutive slots of the transform stream.
+            // instances are the objects' indices in the scene's object store, resolved when the batches are built
+            std::vector<detail::draw_batch> m_draw_batches;
+            std::vector<uint64_t> m_instances;
+            std::vector<assets::mesh_handle> m_meshes;
+            std::vector<assets::material_handle> m_materials;
+
+            // where every mesh placed so far lives in the vertex and index buffers, in the order of m_meshes.
+            // placements survive incremental scene changes, only a full reload starts over
+            std::unordered_map<assets::mesh_handle, detail::draw_batch> m_mesh_ranges;
+            struct {
+                uint64_t n_vertices = 0, n_indices = 0;
+                uint64_t n_uploaded_meshes = 0, n_uploaded_vertices = 0, n_uploaded_indices = 0;
+            } m_geometry;
+
+            // the scene the GPU state was built from, changes of any other scene need a full reload
+            const scene::instance* m_built_scene = nullptr;
+
+            // destructors of resources replaced while frames in flight may still use them, per frame in flight.
+            // a frame's list runs once its fence is waited on again, by then every older frame has been waited on too
+            std::vector<std::vector<std::function<void()>>> m_retired;
+
+            // fallback for devices without gpu culling, world space bounding spheres of every instance in SoA layout.
+            // the arrays are padded to a multiple of the SIMD width, the visible instance count of each batch is kept
+            // for the draw commands
+            struct {
+                std::vector<float32_t> x, y, z, radius;
+                std::vector<uint8_t> inside;
+                std::vector<uint32_t> visible_counts;
+            } m_cpu_culling;
 
-            std::unordered_map<uint64_t, std::unordered_map<assets::texture::etype, renderer::texture>> m_textures;
+            std::unordered_map<assets::material_handle, std::unordered_map<assets::texture::etype, renderer::texture>> m_textures;
 
             struct {
                 ImGuiContext* imgui_ctx = nullptr;
             } m_gui;
 
+            // gathered from every recording thread's bind_state once the frame's draws are recorded
+            struct {
+                uint32_t packets = 0;
+                uint32_t binds = 0;
+                // binds if every packet bound its whole state (binds_per_packet each)
+                uint32_t naive_binds = 0;
+            } m_draw_statistics;
+
           public:
             renderer(engine::instance& parent);
 
@@ -313,9 +819,14 @@ namespace arbor {
             std::expected<uint32_t, std::string> acquire_image();
             std::expected<void, std::string> reload_swapchain();
             std::expected<void, std::string> update_ubos();
-            std::expected<void, std::string> draw_gui();
+            std::expected<void, std::string> update_draw_commands();
+            std::expected<void, std::string> cull_instances(uint32_t* visible);
+            std::expected<void, std::string> draw_gui(VkCommandBuffer command_buffer);
 
             std::expected<void, std::string> record_command_buffer();
+            std::expected<void, std::string> record_secondary_command_buffers(const VkRenderPassBeginInfo& render_pass);
+            void record_draws(VkCommandBuffer command_buffer, detail::bind_state& state, uint64_t first_batch,
+                              uint64_t last_batch);
             std::expected<void, std::string> submit_and_present_current_command_buffer();
 
             std::expected<void, std::string> init_imgui();
@@ -323,21 +834,34 @@ namespace arbor {
 
             std::expected<void, std::string> make_vk_instance();
             std::expected<void, std::string> make_vk_device();
+            void update_occlusion_culling();
             std::expected<void, std::string> make_vk_surface();
             std::expected<void, std::string> make_vk_pipeline();
+            void reload_changed_shaders();
+            std::expected<void, std::string> make_vk_pipeline_cache();
+            std::expected<void, std::string> save_vk_pipeline_cache();
             std::expected<void, std::string> make_vk_swapchain_and_pipeline();
             std::expected<void, std::string> make_vk_command_pool_and_buffers();
             std::expected<void, std::string> make_sync_objects();
 
-            std::expected<void, std::string> make_vertex_buffer();
-            std::expected<void, std::string> make_index_buffer();
+            std::expected<void, std::string> build_draw_batches();
+
+            std::expected<void, std::string> upload_meshes();
+            std::expected<void, std::string> append_to_buffer(renderer::device_buffer& buffer, VkBufferUsageFlags usage,
+                                                              uint64_t used, const void* bytes, uint64_t size);
             std::expected<void, std::string> make_uniform_buffers();
+            std::expected<void, std::string> make_indirect_buffer();
 
             std::expected<void, std::string> reload_scene();
+            std::expected<void, std::string> apply_scene_changes();
+
+            void retire(std::function<void()> destroy);
+            void release_retired(uint32_t frame);
 
-            std::expected<std::tuple<VkImage, VkImageView, VkDeviceMemory>, std::string>
+            std::expected<std::tuple<VkImage, VkImageView, renderer::device_allocator::allocation>, std::string>
             make_image(uint32_t width, uint32_t height, VkFormat format, VkImageUsageFlags usage, VkImageAspectFlags aspect_mask,
-                       VkMemoryPropertyFlags memory_props, VkSampleCountFlagBits sample_count = VK_SAMPLE_COUNT_1_BIT);
+                       VkMemoryPropertyFlags memory_props, VkSampleCountFlagBits sample_count = VK_SAMPLE_COUNT_1_BIT,
+                       std::span<const uint32_t> queue_families = {}, uint32_t mip_levels = 1);
 
             std::expected<void, std::string> transition_image_layout(VkImage image, VkImageAspectFlags aspect_mask,
                                                                      VkImageLayout old_layout, VkImageLayout new_layout);
@@ -17,6 +17,10 @@ namespace arbor {
         struct object_callback_config {
             std::optional<std::function<void(engine::instance&, uint64_t id)>> on_init;
             std::optional<std::function<void(engine::instance&, uint64_t id)>> on_update;
+
+            // on_update only touches its own object (and synchronizes anything else it shares), so it may run on a
+            // worker thread next to other objects' updates. structural scene changes have to go through scene::defer
+            bool thread_safe = false;
         };
 
         struct internal_callback_config {
@@ -30,6 +34,13 @@ namespace arbor {
             } window;
 
             callback_config callbacks;
+
+            // threads the job system spawns next to the main one, 0 leaves one hardware thread for the main thread
+            uint32_t worker_threads = 0;
+
+            // run the on_update of objects declared thread-safe in parallel batches on the job system
+            bool parallel_object_updates = false;
+            uint32_t object_update_grain = 256;
         };
 
     } // namespace engine
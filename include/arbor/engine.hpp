@@ -12,6 +12,7 @@
 #include "arbor/components/components.hpp"
 #include "arbor/configs.hpp"
 #include "arbor/input_manager.hpp"
+#include "arbor/job_system.hpp"
 #include "arbor/logger_utils.hpp"
 #include "arbor/scene/scene.hpp"
 #include "arbor/types.hpp"
@@ -26,6 +27,7 @@ namespace arbor {
             engine::application_config m_config;
             std::shared_ptr<spdlog::logger> m_logger;
 
+            engine::job_system m_jobs;
             engine::window m_window;
             engine::input_manager m_input_manager;
             std::unordered_map<engine::component::etype, std::unique_ptr<engine::component>> m_components;
@@ -34,6 +36,9 @@ namespace arbor {
             std::unordered_map<std::string, scene::instance> m_scenes;
             std::optional<std::unordered_map<std::string, scene::instance>::iterator> m_current_scene;
 
+            // store indices of the objects whose on_update runs on the job system this frame
+            std::vector<uint64_t> m_parallel_updates;
+
             uint64_t m_frame_count = 0;
             float64_t m_frame_time_ns = 0;
             bool m_camera_ownership = false;
@@ -55,6 +60,7 @@ namespace arbor {
             constexpr auto& scenes() { return m_scenes; }
             constexpr auto& scenes() const { return m_scenes; }
             constexpr auto& input_manager() const { return m_input_manager; }
+            constexpr auto& jobs() { return m_jobs; }
             constexpr auto& current_scene() { return m_current_scene.value()->second; }
             constexpr auto& current_scene() const { return m_current_scene.value()->second; }
 
@@ -0,0 +1,49 @@
+#pragma once
+#include <filesystem>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "spdlog/spdlog.h"
+
+#include "arbor/types.hpp"
+
+namespace arbor {
+    namespace engine {
+        // reports files that were written to since the last poll. on linux it listens to inotify events on the files'
+        // directories, editors that save by renaming a temporary file over the original are caught that way too.
+        // elsewhere, or if inotify can't be set up, the files' modification times are compared on every poll
+        class file_watcher {
+            struct watched_file {
+                std::filesystem::path path;
+                std::filesystem::path absolute_path;
+                std::filesystem::file_time_type last_write;
+            };
+
+            std::shared_ptr<spdlog::logger> m_logger;
+            std::vector<file_watcher::watched_file> m_files;
+
+            int32_t m_inotify = -1;
+            bool m_inotify_initialized = false;
+            // watch descriptor -> watched directory
+            std::unordered_map<int32_t, std::filesystem::path> m_directories;
+
+          public:
+            file_watcher();
+            ~file_watcher();
+
+            file_watcher(file_watcher&&) = delete;
+            file_watcher(const file_watcher&) = delete;
+
+            void watch(const std::filesystem::path& path);
+            void clear();
+
+            // paths as they were passed to watch(), every changed file is reported once
+            std::vector<std::filesystem::path> poll();
+
+          private:
+            std::vector<std::filesystem::path> poll_inotify();
+            std::vector<std::filesystem::path> poll_modification_times();
+        };
+    } // namespace engine
+} // namespace arbor
\ No newline at end of file
@@ -0,0 +1,31 @@
+#pragma once
+#include <string_view>
+
+#include "arbor/types.hpp"
+
+namespace arbor {
+    // 64-bit FNV-1a, stable across runs and platforms so it can key on-disk caches as well
+    inline uint64_t hash_bytes(const void* data, uint64_t size, uint64_t seed = 0xcbf29ce484222325ull) {
+        auto bytes = static_cast<const unsigned char*>(data);
+
+        for (auto i = 0ull; i < size; i++) {
+            seed ^= bytes[i];
+            seed *= 0x100000001b3ull;
+        }
+
+        return seed;
+    }
+
+    constexpr uint64_t hash_string(std::string_view string, uint64_t seed = 0xcbf29ce484222325ull) {
+        for (auto c : string) {
+            seed ^= static_cast<unsigned char>(c);
+            seed *= 0x100000001b3ull;
+        }
+
+        return seed;
+    }
+
+    constexpr uint64_t hash_combine(uint64_t seed, uint64_t value) {
+        return seed ^ (value + 0x9e3779b97f4a7c15ull + (seed << 6) + (seed >> 2));
+    }
+} // namespace arbor
\ No newline at end of file
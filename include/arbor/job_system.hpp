@@ -0,0 +1,132 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <thread>
+#include <vector>
+
+#include "spdlog/spdlog.h"
+
+#include "arbor/types.hpp"
+
+namespace arbor {
+    namespace engine {
+        namespace detail {
+            struct job {
+                std::function<void()> function;
+
+                // one for every unfinished dependency plus one held by submit() until the job is fully wired up
+                std::atomic<uint32_t> blockers = 1;
+                std::atomic<bool> finished = false;
+
+                std::mutex mutex;
+                std::vector<std::shared_ptr<detail::job>> continuations;
+            };
+        } // namespace detail
+
+        // work-stealing scheduler, every worker owns a deque it pushes to and pops from at the back while idle
+        // workers steal from the front of the others'. threads that aren't workers (the main thread) submit into
+        // their own shared queue and help execute jobs while they wait on one
+        class job_system {
+          public:
+            class handle {
+                friend class engine::job_system;
+                std::shared_ptr<detail::job> m_job;
+
+                handle(std::shared_ptr<detail::job> job) : m_job(std::move(job)) {}
+
+              public:
+                handle() = default;
+
+                bool done() const { return !m_job || m_job->finished.load(std::memory_order_acquire); }
+            };
+
+          private:
+            struct queue {
+                std::mutex mutex;
+                std::deque<std::shared_ptr<detail::job>> jobs;
+            };
+
+            std::shared_ptr<spdlog::logger> m_logger;
+
+            std::vector<std::jthread> m_workers;
+            std::vector<std::unique_ptr<job_system::queue>> m_queues;
+
+            std::atomic<int64_t> m_queued = 0;
+            std::mutex m_sleep_mutex;
+            std::condition_variable_any m_wake;
+
+            // long running jobs get a thread of their own, nothing that waits ever picks them up
+            std::jthread m_background;
+            std::mutex m_background_mutex;
+            std::condition_variable_any m_background_wake;
+            std::deque<std::shared_ptr<detail::job>> m_background_jobs;
+
+          public:
+            job_system();
+            ~job_system();
+
+            job_system(job_system&&) = delete;
+            job_system(const job_system&) = delete;
+
+            // n_workers = 0 picks one less than the hardware concurrency, leaving a core for the calling thread
+            void start(uint32_t n_workers = 0);
+            void stop();
+
+            // number of threads that execute jobs, the calling thread included
+            uint32_t concurrency() const { return m_workers.size() + 1; }
+
+            handle submit(std::function<void()> function, std::span<const handle> dependencies = {});
+            handle submit(std::function<void()> function, std::initializer_list<handle> dependencies) {
+                return submit(std::move(function), std::span(dependencies.begin(), dependencies.size()));
+            }
+
+            // for work that takes longer than a frame (pipeline builds, ...). it runs in submission order on the background
+            // thread, wait() never executes it inline, so a frame that waits on other jobs isn't held up by it
+            handle submit_background(std::function<void()> function);
+
+            // runs queued jobs on the calling thread until the awaited ones are finished, so it's safe to call from a job
+            void wait(const handle& job);
+            void wait(std::span<const handle> jobs);
+
+            // splits [0, count) into chunks of at least `grain` elements, runs them in parallel and joins
+            template <typename Fn> void parallel_for(uint64_t count, uint64_t grain, Fn&& function);
+
+          private:
+            void worker_loop(std::stop_token stop, uint32_t index);
+            void background_loop(std::stop_token stop);
+
+            void enqueue(std::shared_ptr<detail::job> job);
+            std::shared_ptr<detail::job> dequeue();
+            void execute(const std::shared_ptr<detail::job>& job);
+        };
+
+        template <typename Fn> void job_system::parallel_for(uint64_t count, uint64_t grain, Fn&& function) {
+            if (count == 0)
+                return;
+
+            const auto n_chunks = std::clamp<uint64_t>(count / std::max<uint64_t>(grain, 1), 1, concurrency());
+            if (n_chunks == 1) {
+                function(0ull, count);
+                return;
+            }
+
+            std::vector<handle> chunks;
+            chunks.reserve(n_chunks - 1);
+
+            for (auto chunk = 1ull; chunk < n_chunks; chunk++)
+                chunks.push_back(submit([&function, count, n_chunks, chunk] {
+                    function(chunk * count / n_chunks, (chunk + 1) * count / n_chunks);
+                }));
+
+            function(0ull, count / n_chunks);
+            wait(chunks);
+        }
+    } // namespace engine
+} // namespace arbor
\ No newline at end of file
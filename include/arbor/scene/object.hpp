@@ -1,27 +1,129 @@
 #pragma once
+#include <vector>
+
 #include "arbor/assets/model.hpp"
 #include "arbor/configs.hpp"
 #include "arbor/types.hpp"
 
 namespace arbor {
     namespace engine {
+        class object_store;
+
+        // generational handle to an object, the index of its slot in the store and the generation the slot had when
+        // the object was created. destroying an object bumps its slot's generation, so handles to it go stale instead
+        // of silently referring to whatever reuses the slot. the packed 64-bit value is what callbacks and the asset
+        // library key on
+        struct object_handle {
+            constexpr static uint32_t invalid_index = -1;
+
+            uint32_t index = invalid_index;
+            uint32_t generation = 0;
+
+            constexpr object_handle() = default;
+            constexpr object_handle(uint32_t index, uint32_t generation) : index(index), generation(generation) {}
+            constexpr object_handle(uint64_t packed) : index(packed & 0xffffffffu), generation(packed >> 32) {}
+
+            constexpr uint64_t packed() const { return static_cast<uint64_t>(generation) << 32 | index; }
+            constexpr operator uint64_t() const { return packed(); }
+
+            constexpr bool operator==(const object_handle& other) const = default;
+        };
+
+        // a view of one object's slot in an object_store. it's only valid until the store's layout changes, which
+        // is when an object is created or erased
         class object {
-            uint64_t m_id = -1;
+            engine::object_store* m_store = nullptr;
+            uint64_t m_index = -1;
+
+          public:
+            object() = default;
+            object(engine::object_store& store, uint64_t index) : m_store(&store), m_index(index) {}
+
+            constexpr auto index() const { return m_index; }
+
+            engine::object_handle id() const;
+            engine::object_callback_config& callbacks() const;
+            glm::mat4& transform() const;
+        };
+
+        // every component of the scene's objects lives in its own dense array, the per-frame passes walk them
+        // front to back. handles index a slot map that holds the dense index. erasing only invalidates the handle,
+        // compact() then moves the last object into every freed dense index and puts the slots on a free list. the
+        // scene compacts on commit, so dense indices the renderer holds stay valid until it rebuilds from that commit
+        class object_store {
+            struct slot {
+                uint32_t dense = object_handle::invalid_index;
+                uint32_t generation = 0;
+            };
 
-            engine::object_callback_config m_callbacks;
+            std::vector<object_store::slot> m_slots;
+            std::vector<uint32_t> m_free_slots;
+            // dense indices of erased objects that are still in the arrays
+            std::vector<uint32_t> m_pending_erase;
 
-            glm::mat4 m_transform = {1.0f};
+            // packed handle of the object at every dense index, a handle's index leads back to its slot
+            std::vector<uint64_t> m_ids;
+            std::vector<glm::mat4> m_transforms;
+            std::vector<engine::object_callback_config> m_callbacks;
 
           public:
-            object(uint64_t id = -1) : m_id(id) {}
+            class iterator {
+                engine::object_store* m_store = nullptr;
+                uint64_t m_index = 0;
+
+              public:
+                iterator() = default;
+                iterator(engine::object_store& store, uint64_t index) : m_store(&store), m_index(index) {}
+
+                engine::object operator*() const { return {*m_store, m_index}; }
+                iterator& operator++() {
+                    m_index++;
+                    return *this;
+                }
+
+                bool operator==(const iterator& other) const = default;
+            };
+
+            engine::object_handle insert();
+            bool erase(engine::object_handle handle);
+            // true if any object was removed, which moves others to different dense indices
+            bool compact();
+            void clear();
 
-            constexpr auto id() const { return m_id; }
+            // operator[] expects a live handle, at() throws on stale ones
+            engine::object operator[](engine::object_handle handle) { return {*this, m_slots[handle.index].dense}; }
+            engine::object at(engine::object_handle handle);
 
+            bool contains(engine::object_handle handle) const {
+                return handle.index < m_slots.size() && m_slots[handle.index].generation == handle.generation &&
+                       m_slots[handle.index].dense != object_handle::invalid_index;
+            }
+
+            uint64_t index_of(engine::object_handle handle) const { return m_slots[handle.index].dense; }
+
+            constexpr auto size() const { return m_ids.size(); }
+            constexpr auto empty() const { return m_ids.empty(); }
+
+            constexpr auto& ids() const { return m_ids; }
+            constexpr auto& transforms() { return m_transforms; }
+            constexpr auto& transforms() const { return m_transforms; }
             constexpr auto& callbacks() { return m_callbacks; }
             constexpr auto& callbacks() const { return m_callbacks; }
 
-            constexpr auto& transform() { return m_transform; }
-            constexpr auto& transform() const { return m_transform; }
+            iterator begin() { return {*this, 0}; }
+            iterator end() { return {*this, m_ids.size()}; }
         };
+
+        inline engine::object_handle object::id() const {
+            return m_store->ids()[m_index];
+        }
+
+        inline engine::object_callback_config& object::callbacks() const {
+            return m_store->callbacks()[m_index];
+        }
+
+        inline glm::mat4& object::transform() const {
+            return m_store->transforms()[m_index];
+        }
     } // namespace engine
 } // namespace arbor
\ No newline at end of file
@@ -7,12 +7,29 @@
 #include "arbor/scene/object.hpp"
 
 #include <filesystem>
+#include <functional>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 namespace arbor {
     namespace scene {
+        class instance;
+
+        namespace detail {
+            // pending commands belong to the scene they were queued on, copies start out with an empty queue
+            struct deferred_commands {
+                std::mutex mutex;
+                std::vector<std::function<std::expected<void, std::string>(scene::instance&)>> commands;
+
+                deferred_commands() = default;
+                deferred_commands(const deferred_commands&) {}
+                deferred_commands& operator=(const deferred_commands&) { return *this; }
+            };
+        } // namespace detail
+
         class instance {
             friend class engine::instance;
             friend class engine::renderer;
@@ -28,9 +45,17 @@ namespace arbor {
             engine::internal_callback_config m_internal_callbacks;
 
             std::vector<uint64_t> m_drawable_objects;
-            std::unordered_map<uint64_t, engine::object> m_objects;
+            engine::object_store m_objects;
+
+            // the asset entries of the drawable objects as of the last commit, and whether a commit changed what's drawn
+            // since the renderer last looked
+            std::unordered_map<uint64_t, assets::library::entry> m_committed;
+            bool m_dirty = false;
             std::unordered_map<std::string, std::shared_ptr<scene::controls::control>> m_controls;
 
+            // structural changes requested while object updates run in parallel, applied by the engine afterwards
+            detail::deferred_commands m_deferred;
+
           public:
             instance(const std::string& name, const std::filesystem::path& vertex_shader_src = "",
                      const std::filesystem::path& fragment_shader_src = "");
@@ -40,7 +65,9 @@ namespace arbor {
             constexpr auto vertex_shader(const std::filesystem::path& src) { m_vertex_shader = src; }
             constexpr auto fragment_shader(const std::filesystem::path& src) { m_fragment_shader = src; }
 
-            std::expected<uint64_t, std::string> create_object();
+            std::expected<engine::object_handle, std::string> create_object();
+            // takes effect for rendering on the next commit, like creating objects does
+            std::expected<void, std::string> destroy_object(engine::object_handle handle);
 
             constexpr auto& vertex_shader() const { return m_vertex_shader; }
             constexpr auto& fragment_shader() const { return m_fragment_shader; }
@@ -55,7 +82,15 @@ namespace arbor {
             constexpr auto& controls() const { return m_controls; }
 
             std::expected<void, std::string> commit();
-            bool is_object_drawable(uint64_t object_id);
+            bool is_object_drawable(engine::object_handle object_id);
+
+            // whether any commit since the last call added, removed or moved a drawable object or changed its assets
+            bool take_dirty();
+
+            // queues a command that changes the scene's structure (create_object, commit, ...), safe to call from any
+            // thread. commands run in submission order on the main thread once this frame's object updates are done
+            void defer(std::function<std::expected<void, std::string>(scene::instance&)> command);
+            std::expected<void, std::string> execute_deferred();
 
             template <typename T> constexpr void add_control(const std::string& label, const auto&... ctor_args);
             template <typename T>
@@ -0,0 +1,28 @@
+#include "arbor/assets/library.hpp"
+
+namespace arbor {
+    namespace assets {
+        assets::mesh_handle library::add_mesh(const assets::model_3d& model) {
+            auto handle = model.hash();
+
+            // probe past hash collisions, the handle only has to be unique within this library
+            while (handle == assets::invalid_handle || (m_meshes.contains(handle) && m_meshes.at(handle) != model))
+                handle++;
+
+            if (auto [it, inserted] = m_meshes.try_emplace(handle, model); inserted)
+                it->second.update_bounds();
+
+            return handle;
+        }
+
+        assets::material_handle library::add_material(const assets::material& material) {
+            auto handle = material.hash();
+
+            while (handle == assets::invalid_handle || (m_materials.contains(handle) && m_materials.at(handle) != material))
+                handle++;
+
+            m_materials.try_emplace(handle, material);
+            return handle;
+        }
+    } // namespace assets
+} // namespace arbor
\ No newline at end of file
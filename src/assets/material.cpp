@@ -1,4 +1,9 @@
 #include "arbor/assets/material.hpp"
+#include "arbor/hash.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
 
 namespace arbor {
     namespace assets {
@@ -9,5 +14,53 @@ namespace arbor {
 
             return out;
         }
+
+        uint64_t material::hash() const {
+            std::vector<assets::texture::etype> types;
+            for (const auto& [type, texture] : m_textures)
+                types.push_back(type);
+
+            std::ranges::sort(types);
+
+            uint64_t out = hash_combine(hash_string(m_vertex_shader.string()), hash_string(m_fragment_shader.string()));
+            for (auto type : types) {
+                const auto& texture = m_textures.at(type);
+                out = hash_combine(out, type);
+
+                // textures are loaded lazily, so files are identified by their path and generated ones by their pixels
+                if (texture.source() && texture.source() != "generator")
+                    out = hash_combine(out, hash_string(texture.source()->string()));
+                else
+                    out = hash_combine(out, hash_bytes(texture.pixels().data(),
+                                                       texture.pixels().size() * sizeof(*texture.pixels().begin())));
+            }
+
+            return out;
+        }
+
+        bool material::operator==(const material& other) const {
+            if (m_textures.size() != other.m_textures.size() || m_vertex_shader != other.m_vertex_shader ||
+                m_fragment_shader != other.m_fragment_shader)
+                return false;
+
+            for (const auto& [type, texture] : m_textures) {
+                if (!other.m_textures.contains(type))
+                    return false;
+
+                const auto& other_texture = other.m_textures.at(type);
+                if (texture.source() != other_texture.source())
+                    return false;
+
+                if (texture.source() && texture.source() != "generator")
+                    continue;
+
+                if (texture.pixels().size() != other_texture.pixels().size() ||
+                    std::memcmp(texture.pixels().data(), other_texture.pixels().data(),
+                                texture.pixels().size() * sizeof(*texture.pixels().begin())))
+                    return false;
+            }
+
+            return true;
+        }
     } // namespace assets
 } // namespace arbor
\ No newline at end of file
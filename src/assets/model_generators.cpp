@@ -1,4 +1,8 @@
 #include "arbor/assets/model.hpp"
+#include "arbor/hash.hpp"
+
+#include <algorithm>
+#include <cstring>
 
 namespace arbor {
     namespace assets {
@@ -29,6 +33,40 @@ namespace arbor {
             return {binding_description, attribute_descriptions};
         }
 
+        void model_3d::update_bounds() {
+            bounds = {};
+
+            if (vertices.empty())
+                return;
+
+            bounds.min = bounds.max = vertices.front().position;
+            for (const auto& vertex : vertices) {
+                bounds.min = glm::min(bounds.min, vertex.position);
+                bounds.max = glm::max(bounds.max, vertex.position);
+            }
+
+            // a sphere around the center of the box, loose but cheap to build and to test against
+            const auto center = (bounds.min + bounds.max) * 0.5f;
+
+            float32_t radius = 0.0f;
+            for (const auto& vertex : vertices)
+                radius = std::max(radius, glm::length(vertex.position - center));
+
+            bounds.sphere = glm::vec4(center, radius);
+        }
+
+        uint64_t model_3d::hash() const {
+            auto out = hash_bytes(vertices.data(), vertices.size() * sizeof(*vertices.begin()));
+            return hash_bytes(indices.data(), indices.size() * sizeof(*indices.begin()), out);
+        }
+
+        bool model_3d::operator==(const model_3d& other) const {
+            if (vertices.size() != other.vertices.size() || indices != other.indices)
+                return false;
+
+            return !std::memcmp(vertices.data(), other.vertices.data(), vertices.size() * sizeof(*vertices.begin()));
+        }
+
         model_3d model_3d::cube(float32_t scale_x, float32_t scale_y, float32_t scale_z) {
             model_3d out;
 
@@ -53,6 +91,8 @@ namespace arbor {
                 7, 6, 5, 7, 5, 4, // back | HGF, HFE
             };
 
+            out.update_bounds();
+
             return out;
         }
 
@@ -90,6 +130,8 @@ namespace arbor {
                 9,  8, 13, 9,  13, 12, // back | LKW, LWX
             };
 
+            out.update_bounds();
+
             return out;
         }
 
@@ -108,6 +150,8 @@ namespace arbor {
                 3, 2, 0, 2, 1, 0, // back | DCA, CBA
             };
 
+            out.update_bounds();
+
             return out;
         }
     } // namespace assets
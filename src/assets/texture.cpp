@@ -1,6 +1,10 @@
 #include "arbor/assets/texture.hpp"
 
 #include <algorithm>
+#include <array>
+#include <bit>
+#include <cstring>
+#include <fstream>
 #include <span>
 
 #include "fmt/format.h"
@@ -8,13 +12,251 @@
 
 namespace arbor {
     namespace assets {
-        std::expected<void, std::string> texture::load() {
+        namespace {
+            struct block_image {
+                texture::eformat format;
+                int32_t width = 0, height = 0;
+                std::vector<uint8_t> blocks;
+                std::vector<texture::mip_level> levels;
+            };
+
+            template <typename T> T read(std::span<const uint8_t> bytes, uint64_t offset) {
+                T out{};
+                if (offset + sizeof(T) <= bytes.size())
+                    std::memcpy(&out, bytes.data() + offset, sizeof(T));
+                return out;
+            }
+
+            std::expected<std::vector<uint8_t>, std::string> read_file(const std::filesystem::path& path) {
+                std::ifstream stream(path, std::ios::binary);
+                if (!stream)
+                    return std::unexpected(fmt::format("failed to open '{}': {}", path.string(), std::strerror(errno)));
+
+                return std::vector<uint8_t>{std::istreambuf_iterator(stream), std::istreambuf_iterator<char>()};
+            }
+
+            // the extent and level count come straight from the file. a chain ends at 1x1, more levels than that would
+            // shift the extent past its width and ask vulkan for more mips than the image can have
+            std::expected<void, std::string> check_extent(const block_image& image, uint32_t n_levels) {
+                if (image.width <= 0 || image.height <= 0)
+                    return std::unexpected(fmt::format("invalid extent {}x{}", image.width, image.height));
+
+                if (const auto max_levels = std::bit_width(static_cast<uint32_t>(std::max(image.width, image.height)));
+                    n_levels > max_levels)
+                    return std::unexpected(fmt::format("{} levels, a {}x{} image has at most {}", n_levels, image.width,
+                                                       image.height, max_levels));
+
+                return {};
+            }
+
+            // copies `n_levels` levels laid out back to back from `offset` on, the way dds stores them
+            std::expected<void, std::string> read_levels(block_image& image, std::span<const uint8_t> file, uint64_t offset,
+                                                         uint32_t n_levels) {
+                for (auto level = 0u; level < n_levels; level++) {
+                    const auto width = std::max(image.width >> level, 1);
+                    const auto height = std::max(image.height >> level, 1);
+                    const auto size = texture::level_size(image.format, width, height);
+
+                    if (offset > file.size() || size > file.size() - offset)
+                        return std::unexpected("the file is truncated");
+
+                    image.levels.push_back({.offset = image.blocks.size(), .size = size, .width = width, .height = height});
+                    image.blocks.insert(image.blocks.end(), file.begin() + offset, file.begin() + offset + size);
+                    offset += size;
+                }
+
+                return {};
+            }
+
+            std::expected<block_image, std::string> parse_dds(std::span<const uint8_t> file) {
+                constexpr uint32_t magic = 0x20534444;        // "DDS "
+                constexpr uint32_t fourcc_dxt1 = 0x31545844;  // "DXT1"
+                constexpr uint32_t fourcc_dxt5 = 0x35545844;  // "DXT5"
+                constexpr uint32_t fourcc_dx10 = 0x30315844;  // "DX10"
+                constexpr uint32_t flag_mip_count = 0x20000;
+                constexpr uint32_t pixel_format_fourcc = 0x4;
+                constexpr uint32_t caps2_cubemap = 0x200;
+
+                if (file.size() < 128 || read<uint32_t>(file, 0) != magic || read<uint32_t>(file, 4) != 124)
+                    return std::unexpected("not a dds file");
+
+                block_image image;
+                image.height = read<uint32_t>(file, 12);
+                image.width = read<uint32_t>(file, 16);
+
+                const auto n_levels = read<uint32_t>(file, 8) & flag_mip_count ? std::max(read<uint32_t>(file, 28), 1u) : 1u;
+
+                if (!(read<uint32_t>(file, 80) & pixel_format_fourcc))
+                    return std::unexpected("uncompressed dds files aren't supported");
+
+                if (read<uint32_t>(file, 112) & caps2_cubemap)
+                    return std::unexpected("cubemaps aren't supported");
+
+                auto offset = 128ull;
+
+                switch (read<uint32_t>(file, 84)) {
+                case fourcc_dxt1: image.format = texture::eformat::bc1; break;
+                case fourcc_dxt5: image.format = texture::eformat::bc3; break;
+                case fourcc_dx10: {
+                    if (file.size() < 148)
+                        return std::unexpected("the file is truncated");
+
+                    // only single 2d textures, dimension 3 is TEXTURE2D
+                    if (read<uint32_t>(file, 132) != 3 || read<uint32_t>(file, 140) > 1)
+                        return std::unexpected("only single 2d textures are supported");
+
+                    // DXGI_FORMAT_BC1_UNORM and _SRGB, BC3 and BC7 likewise
+                    switch (read<uint32_t>(file, 128)) {
+                    case 71:
+                    case 72: image.format = texture::eformat::bc1; break;
+                    case 77:
+                    case 78: image.format = texture::eformat::bc3; break;
+                    case 98:
+                    case 99: image.format = texture::eformat::bc7; break;
+                    default: return std::unexpected(fmt::format("unsupported dxgi format {}", read<uint32_t>(file, 128)));
+                    }
+
+                    offset = 148;
+                    break;
+                }
+                default: return std::unexpected("unsupported dds pixel format");
+                }
+
+                if (auto res = check_extent(image, n_levels); !res)
+                    return std::unexpected(res.error());
+
+                if (auto res = read_levels(image, file, offset, n_levels); !res)
+                    return std::unexpected(res.error());
+
+                return image;
+            }
+
+            std::expected<block_image, std::string> parse_ktx2(std::span<const uint8_t> file) {
+                constexpr std::array<uint8_t, 12> identifier = {0xab, 'K', 'T', 'X', ' ', '2', '0', 0xbb, '\r', '\n', 0x1a, '\n'};
+                constexpr uint64_t level_index_offset = 80;
+
+                if (file.size() < level_index_offset || !std::ranges::equal(file.first(identifier.size()), identifier))
+                    return std::unexpected("not a ktx2 file");
+
+                block_image image;
+
+                // VK_FORMAT_BC1_RGB_UNORM_BLOCK through _RGBA_SRGB_BLOCK, BC3 and BC7 unorm and srgb
+                switch (const auto vk_format = read<uint32_t>(file, 12)) {
+                case 131:
+                case 132:
+                case 133:
+                case 134: image.format = texture::eformat::bc1; break;
+                case 137:
+                case 138: image.format = texture::eformat::bc3; break;
+                case 145:
+                case 146: image.format = texture::eformat::bc7; break;
+                default: return std::unexpected(fmt::format("unsupported vulkan format {}", vk_format));
+                }
+
+                image.width = read<uint32_t>(file, 20);
+                image.height = read<uint32_t>(file, 24);
+
+                if (read<uint32_t>(file, 28) > 0 || read<uint32_t>(file, 32) > 1 || read<uint32_t>(file, 36) != 1)
+                    return std::unexpected("only single 2d textures are supported");
+
+                if (read<uint32_t>(file, 44) != 0)
+                    return std::unexpected("supercompressed ktx2 files aren't supported");
+
+                // a level count of 0 asks the loader to generate the chain, compressed levels can't be blitted though
+                const auto n_levels = std::max(read<uint32_t>(file, 40), 1u);
+                if (auto res = check_extent(image, n_levels); !res)
+                    return std::unexpected(res.error());
+
+                if (level_index_offset + n_levels * 24ull > file.size())
+                    return std::unexpected("the file is truncated");
+
+                // the index lists level 0 first, the data is stored smallest level first
+                for (auto level = 0u; level < n_levels; level++) {
+                    const auto offset = read<uint64_t>(file, level_index_offset + level * 24ull);
+                    const auto length = read<uint64_t>(file, level_index_offset + level * 24ull + 8);
+
+                    const auto width = std::max(image.width >> level, 1);
+                    const auto height = std::max(image.height >> level, 1);
+
+                    if (length != texture::level_size(image.format, width, height))
+                        return std::unexpected(fmt::format("level {} has an unexpected size", level));
+
+                    if (offset > file.size() || length > file.size() - offset)
+                        return std::unexpected("the file is truncated");
+
+                    image.levels.push_back({.offset = image.blocks.size(), .size = length, .width = width, .height = height});
+                    image.blocks.insert(image.blocks.end(), file.begin() + offset, file.begin() + offset + length);
+                }
+
+                return image;
+            }
+        } // namespace
+
+        std::expected<void, std::string> texture::load(std::span<const texture::eformat> supported) {
             if (!m_source)
                 return std::unexpected("missing source for texture");
 
             if (m_source == "generator")
                 return {};
 
+            const auto parse = [](const std::filesystem::path& path) -> std::expected<block_image, std::string> {
+                auto file = read_file(path);
+                if (!file)
+                    return std::unexpected(file.error());
+
+                auto image = path.extension() == ".dds" ? parse_dds(*file) : parse_ktx2(*file);
+                if (!image)
+                    return std::unexpected(fmt::format("failed to load '{}': {}", path.string(), image.error()));
+
+                return image;
+            };
+
+            const auto use = [&](block_image&& image) {
+                m_format = image.format;
+                m_width = image.width;
+                m_height = image.height;
+                m_blocks = std::move(image.blocks);
+                m_levels = std::move(image.levels);
+                m_pixels.clear();
+            };
+
+            const auto is_supported = [&](texture::eformat format) {
+                return std::ranges::find(supported, format) != supported.end();
+            };
+
+            if (m_source->extension() == ".ktx2" || m_source->extension() == ".dds") {
+                auto image = parse(*m_source);
+                if (!image)
+                    return std::unexpected(image.error());
+
+                if (!is_supported(image->format))
+                    return std::unexpected(fmt::format("'{}' is in a compressed format that can't be used", m_source->string()));
+
+                use(std::move(*image));
+                return {};
+            }
+
+            // compressed versions written by the texture compressor, stale or unusable ones fall back to the source
+            std::error_code error;
+            const auto source_time = std::filesystem::last_write_time(*m_source, error);
+
+            for (const auto* extension : {".ktx2", ".dds"}) {
+                if (supported.empty())
+                    break;
+
+                auto compressed = *m_source;
+                compressed.replace_extension(extension);
+
+                const auto compressed_time = std::filesystem::last_write_time(compressed, error);
+                if (error || compressed_time < source_time)
+                    continue;
+
+                if (auto image = parse(compressed); image && is_supported(image->format)) {
+                    use(std::move(*image));
+                    return {};
+                }
+            }
+
             int32_t _;
 
             if (auto raw_data = stbi_load(m_source->c_str(), &m_width, &m_height, &_, 4); raw_data != nullptr) {
@@ -26,6 +268,10 @@ namespace arbor {
                 return std::unexpected(fmt::format("stb failed to load '{}'", m_source->string()));
             }
 
+            m_format = eformat::rgba8;
+            m_blocks.clear();
+            m_levels = {{.offset = 0, .size = level_size(m_format, m_width, m_height), .width = m_width, .height = m_height}};
+
             return {};
         }
 
@@ -33,9 +279,13 @@ namespace arbor {
             m_width = std::max(0, width);
             m_height = std::max(0, height);
 
-            m_pixels.resize(m_width * m_width);
+            m_pixels.resize(m_width * m_height);
             std::ranges::fill(m_pixels, color);
 
+            m_format = eformat::rgba8;
+            m_blocks.clear();
+            m_levels = {{.offset = 0, .size = level_size(m_format, m_width, m_height), .width = m_width, .height = m_height}};
+
             m_source = "generator";
             return {};
         }
@@ -68,6 +68,8 @@ namespace arbor {
                 return std::unexpected("already running");
 
             m_config = app_config;
+            m_jobs.start(m_config.worker_threads);
+
             if (auto res = create_app(); !res)
                 return res;
 
@@ -154,11 +156,31 @@ namespace arbor {
             }
 
             if (m_current_scene) {
-                for (auto& [id, object] : m_current_scene.value()->second.objects()) {
-                    if (object.callbacks().on_update.has_value()) {
-                        std::invoke(*object.callbacks().on_update, *this, id);
+                auto& objects = current_scene().objects();
+                const auto& callbacks = objects.callbacks();
+                const auto& ids = objects.ids();
+
+                m_parallel_updates.clear();
+
+                // the store's arrays must not reallocate while their callbacks run, updates create objects through defer
+                for (auto i = 0ull; i < objects.size(); i++) {
+                    if (callbacks[i].on_update.has_value()) {
+                        if (m_config.parallel_object_updates && callbacks[i].thread_safe)
+                            m_parallel_updates.push_back(i);
+                        else
+                            std::invoke(*callbacks[i].on_update, *this, ids[i]);
                     }
                 }
+
+                const auto update_objects = [&](uint64_t first, uint64_t last) {
+                    for (auto i = first; i < last; i++)
+                        std::invoke(*callbacks[m_parallel_updates[i]].on_update, *this, ids[m_parallel_updates[i]]);
+                };
+
+                m_jobs.parallel_for(m_parallel_updates.size(), m_config.object_update_grain, update_objects);
+
+                if (auto res = current_scene().execute_deferred(); !res)
+                    return res;
             }
 
             return {};
@@ -0,0 +1,149 @@
+#include "arbor/file_watcher.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstring>
+
+#include "arbor/logger_utils.hpp"
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace arbor {
+    namespace engine {
+        namespace {
+            std::filesystem::file_time_type modification_time(const std::filesystem::path& path) {
+                std::error_code error;
+                const auto time = std::filesystem::last_write_time(path, error);
+                return error ? std::filesystem::file_time_type::min() : time;
+            }
+        } // namespace
+
+        file_watcher::file_watcher() {
+            m_logger = arbor::make_logger("file watcher");
+        }
+
+        file_watcher::~file_watcher() {
+#ifdef __linux__
+            if (m_inotify >= 0)
+                close(m_inotify);
+#endif
+        }
+
+        void file_watcher::watch(const std::filesystem::path& path) {
+            std::error_code error;
+            auto absolute_path = std::filesystem::weakly_canonical(path, error);
+            if (error)
+                absolute_path = std::filesystem::absolute(path);
+
+            if (std::ranges::any_of(m_files, [&](const auto& file) { return file.absolute_path == absolute_path; }))
+                return;
+
+            m_files.push_back({path, absolute_path, modification_time(path)});
+            m_logger->debug("watching {}", path.string());
+
+#ifdef __linux__
+            // inotify is only set up once something is watched, an unused watcher costs nothing
+            if (!m_inotify_initialized) {
+                m_inotify_initialized = true;
+
+                m_inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+                if (m_inotify < 0)
+                    m_logger->warn("failed to initialize inotify, falling back to polling: {}", std::strerror(errno));
+            }
+
+            if (m_inotify < 0)
+                return;
+
+            const auto directory = absolute_path.parent_path();
+            if (std::ranges::any_of(m_directories, [&](const auto& watched) { return watched.second == directory; }))
+                return;
+
+            // the directory is watched rather than the file, a rename over the file would leave a watch on it orphaned
+            const auto descriptor = inotify_add_watch(m_inotify, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+            if (descriptor < 0) {
+                m_logger->warn("failed to watch {}, falling back to polling: {}", directory.string(), std::strerror(errno));
+                close(m_inotify);
+                m_inotify = -1;
+                m_directories.clear();
+                return;
+            }
+
+            m_directories[descriptor] = directory;
+#endif
+        }
+
+        void file_watcher::clear() {
+#ifdef __linux__
+            for (const auto& [descriptor, directory] : m_directories)
+                inotify_rm_watch(m_inotify, descriptor);
+#endif
+
+            m_directories.clear();
+            m_files.clear();
+        }
+
+        std::vector<std::filesystem::path> file_watcher::poll() {
+            if (m_files.empty())
+                return {};
+
+            if (m_inotify >= 0)
+                return poll_inotify();
+
+            return poll_modification_times();
+        }
+
+        std::vector<std::filesystem::path> file_watcher::poll_inotify() {
+            std::vector<std::filesystem::path> changed;
+
+#ifdef __linux__
+            alignas(inotify_event) std::array<char, 4096> buffer;
+
+            for (;;) {
+                const auto n_read = read(m_inotify, buffer.data(), buffer.size());
+                if (n_read <= 0)
+                    break;
+
+                for (auto offset = 0ll; offset < n_read;) {
+                    const auto* event = reinterpret_cast<const inotify_event*>(buffer.data() + offset);
+                    offset += sizeof(inotify_event) + event->len;
+
+                    const auto directory = m_directories.find(event->wd);
+                    if (directory == m_directories.end() || !event->len)
+                        continue;
+
+                    const auto absolute_path = directory->second / event->name;
+                    for (auto& file : m_files) {
+                        if (file.absolute_path != absolute_path ||
+                            std::ranges::find(changed, file.path) != changed.end())
+                            continue;
+
+                        file.last_write = modification_time(file.path);
+                        changed.push_back(file.path);
+                    }
+                }
+            }
+#endif
+
+            return changed;
+        }
+
+        std::vector<std::filesystem::path> file_watcher::poll_modification_times() {
+            std::vector<std::filesystem::path> changed;
+
+            for (auto& file : m_files) {
+                const auto time = modification_time(file.path);
+                if (time == file.last_write)
+                    continue;
+
+                file.last_write = time;
+                changed.push_back(file.path);
+            }
+
+            return changed;
+        }
+    } // namespace engine
+} // namespace arbor
\ No newline at end of file
@@ -0,0 +1,212 @@
+#include "arbor/job_system.hpp"
+
+#include "arbor/logger_utils.hpp"
+
+namespace arbor {
+    namespace engine {
+        namespace {
+            // index into job_system::m_queues of the calling thread, 0 is shared by every thread that isn't a worker
+            thread_local uint32_t t_queue_index = 0;
+        } // namespace
+
+        job_system::job_system() {
+            m_logger = arbor::make_logger("jobs");
+        }
+
+        job_system::~job_system() {
+            stop();
+        }
+
+        void job_system::start(uint32_t n_workers) {
+            if (!m_workers.empty())
+                return;
+
+            if (n_workers == 0)
+                n_workers = std::max(std::thread::hardware_concurrency(), 2u) - 1;
+
+            m_queues.clear();
+            for (auto i = 0u; i <= n_workers; i++)
+                m_queues.push_back(std::make_unique<job_system::queue>());
+
+            for (auto i = 1u; i <= n_workers; i++)
+                m_workers.emplace_back([this, i](std::stop_token stop) { worker_loop(stop, i); });
+
+            m_background = std::jthread([this](std::stop_token stop) { background_loop(stop); });
+
+            m_logger->debug("started {} worker threads", n_workers);
+        }
+
+        void job_system::stop() {
+            for (auto& worker : m_workers)
+                worker.request_stop();
+
+            m_wake.notify_all();
+            m_workers.clear();
+
+            // the background thread finishes what's queued before it exits
+            if (m_background.joinable()) {
+                m_background.request_stop();
+                m_background_wake.notify_all();
+                m_background.join();
+            }
+        }
+
+        job_system::handle job_system::submit(std::function<void()> function, std::span<const handle> dependencies) {
+            auto job = std::make_shared<detail::job>();
+            job->function = std::move(function);
+
+            for (const auto& dependency : dependencies) {
+                if (!dependency.m_job)
+                    continue;
+
+                std::scoped_lock lock(dependency.m_job->mutex);
+                if (dependency.m_job->finished.load(std::memory_order_relaxed))
+                    continue;
+
+                job->blockers.fetch_add(1, std::memory_order_relaxed);
+                dependency.m_job->continuations.push_back(job);
+            }
+
+            // drop the submission blocker, whichever dependency finishes last enqueues the job otherwise
+            if (job->blockers.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                enqueue(job);
+
+            return handle(std::move(job));
+        }
+
+        job_system::handle job_system::submit_background(std::function<void()> function) {
+            auto job = std::make_shared<detail::job>();
+            job->function = std::move(function);
+
+            if (!m_background.joinable()) {
+                execute(job);
+                return handle(std::move(job));
+            }
+
+            {
+                std::scoped_lock lock(m_background_mutex);
+                m_background_jobs.push_back(job);
+            }
+
+            m_background_wake.notify_one();
+            return handle(std::move(job));
+        }
+
+        void job_system::wait(const handle& job) {
+            wait(std::span(&job, 1));
+        }
+
+        void job_system::wait(std::span<const handle> jobs) {
+            for (const auto& job : jobs) {
+                while (!job.done()) {
+                    if (auto next = dequeue())
+                        execute(next);
+                    else
+                        std::this_thread::yield();
+                }
+            }
+        }
+
+        void job_system::worker_loop(std::stop_token stop, uint32_t index) {
+            t_queue_index = index;
+
+            while (!stop.stop_requested()) {
+                if (auto job = dequeue()) {
+                    execute(job);
+                    continue;
+                }
+
+                std::unique_lock lock(m_sleep_mutex);
+                m_wake.wait(lock, stop, [&] { return m_queued.load(std::memory_order_acquire) > 0; });
+            }
+        }
+
+        void job_system::background_loop(std::stop_token stop) {
+            while (true) {
+                std::shared_ptr<detail::job> job;
+                {
+                    std::unique_lock lock(m_background_mutex);
+                    m_background_wake.wait(lock, stop, [&] { return !m_background_jobs.empty(); });
+
+                    if (m_background_jobs.empty())
+                        return;
+
+                    job = std::move(m_background_jobs.front());
+                    m_background_jobs.pop_front();
+                }
+
+                execute(job);
+            }
+        }
+
+        void job_system::enqueue(std::shared_ptr<detail::job> job) {
+            // without workers there's nobody to hand the job to
+            if (m_workers.empty()) {
+                execute(job);
+                return;
+            }
+
+            auto& queue = *m_queues[t_queue_index];
+            {
+                std::scoped_lock lock(queue.mutex);
+                queue.jobs.push_back(std::move(job));
+            }
+
+            {
+                std::scoped_lock lock(m_sleep_mutex);
+                m_queued.fetch_add(1, std::memory_order_release);
+            }
+
+            m_wake.notify_one();
+        }
+
+        std::shared_ptr<detail::job> job_system::dequeue() {
+            if (m_queues.empty())
+                return nullptr;
+
+            const auto own = t_queue_index;
+
+            // newest first from our own queue, it's the most likely to still be in cache
+            {
+                auto& queue = *m_queues[own];
+                std::scoped_lock lock(queue.mutex);
+                if (!queue.jobs.empty()) {
+                    auto job = std::move(queue.jobs.back());
+                    queue.jobs.pop_back();
+                    m_queued.fetch_sub(1, std::memory_order_relaxed);
+                    return job;
+                }
+            }
+
+            // oldest first from everyone else's, those tend to be the largest pieces of work left
+            for (auto i = 1ull; i < m_queues.size(); i++) {
+                auto& queue = *m_queues[(own + i) % m_queues.size()];
+                std::scoped_lock lock(queue.mutex);
+                if (!queue.jobs.empty()) {
+                    auto job = std::move(queue.jobs.front());
+                    queue.jobs.pop_front();
+                    m_queued.fetch_sub(1, std::memory_order_relaxed);
+                    return job;
+                }
+            }
+
+            return nullptr;
+        }
+
+        void job_system::execute(const std::shared_ptr<detail::job>& job) {
+            job->function();
+            job->function = nullptr;
+
+            std::vector<std::shared_ptr<detail::job>> continuations;
+            {
+                std::scoped_lock lock(job->mutex);
+                job->finished.store(true, std::memory_order_release);
+                continuations.swap(job->continuations);
+            }
+
+            for (auto& continuation : continuations)
+                if (continuation->blockers.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                    enqueue(std::move(continuation));
+        }
+    } // namespace engine
+} // namespace arbor
\ No newline at end of file
@@ -0,0 +1,127 @@
+#include "arbor/components/renderer.hpp"
+
+#include <algorithm>
+#include <map>
+#include <unordered_map>
+
+namespace arbor {
+    namespace engine {
+        std::expected<void, std::string> renderer::build_draw_batches() {
+            auto& scene = m_engine.current_scene();
+
+            std::map<std::pair<assets::mesh_handle, assets::material_handle>, uint64_t> batch_indices;
+            std::vector<std::vector<uint64_t>> batch_instances;
+
+            m_draw_batches.clear();
+            m_instances.clear();
+
+            for (auto id : scene.drawable_objects()) {
+                const auto& entry = scene.asset_library().at(id);
+                const auto& model = scene.asset_library().mesh(entry.mesh);
+
+                detail::draw_batch mesh_range{};
+                mesh_range.index_count = model.indices.size();
+                mesh_range.first_index = m_geometry.n_indices;
+                mesh_range.vertex_offset = m_geometry.n_vertices;
+                mesh_range.mesh = entry.mesh;
+                mesh_range.bounds = model.bounds.sphere;
+
+                // a mesh is only uploaded once, even if it's drawn with different materials. meshes placed by an
+                // earlier build keep their ranges, new ones go behind them
+                auto [mesh_it, new_mesh] = m_mesh_ranges.try_emplace(entry.mesh, mesh_range);
+
+                if (new_mesh) {
+                    m_meshes.push_back(entry.mesh);
+                    m_geometry.n_indices += model.indices.size();
+                    m_geometry.n_vertices += model.vertices.size();
+                }
+
+                auto [batch_it, new_batch] = batch_indices.try_emplace({entry.mesh, entry.material}, m_draw_batches.size());
+
+                if (new_batch) {
+                    m_draw_batches.push_back(mesh_it->second);
+                    m_draw_batches.back().material = entry.material;
+                    batch_instances.emplace_back();
+                }
+
+                batch_instances[batch_it->second].push_back(scene.objects().index_of(id));
+            }
+
+            // every material is drawn with the pipeline variant built from its shaders, the scene's stand in for the
+            // stages it doesn't provide. variants are looked up once per material, new ones start building right away
+            std::unordered_map<assets::material_handle, uint32_t> material_sets;
+            std::vector<std::pair<uint32_t, assets::material_handle>> materials;
+
+            for (const auto& batch : m_draw_batches) {
+                if (!material_sets.try_emplace(batch.material, 0).second)
+                    continue;
+
+                const auto& material = scene.asset_library().material(batch.material);
+                const auto variant = m_pipelines.back().variant_index({
+                    {shader::vertex, material.vertex_shader().empty() ? scene.vertex_shader() : material.vertex_shader()},
+                    {shader::fragment,
+                     material.fragment_shader().empty() ? scene.fragment_shader() : material.fragment_shader()},
+                });
+
+                materials.emplace_back(variant, batch.material);
+            }
+
+            // material sets are numbered in pipeline order, so a pipeline's materials are contiguous as well
+            std::ranges::sort(materials);
+            m_materials.clear();
+
+            std::unordered_map<assets::material_handle, uint32_t> material_pipelines;
+            for (const auto& [variant, material] : materials) {
+                material_sets[material] = m_materials.size();
+                material_pipelines[material] = variant;
+                m_materials.push_back(material);
+            }
+
+            std::unordered_map<assets::mesh_handle, uint32_t> mesh_indices;
+            for (auto i = 0u; i < m_meshes.size(); i++)
+                mesh_indices[m_meshes[i]] = i;
+
+            for (auto& batch : m_draw_batches) {
+                batch.pipeline = material_pipelines.at(batch.material);
+                batch.material_set = material_sets.at(batch.material);
+                batch.sort_key = detail::draw_sort_key(batch.pipeline, batch.material_set, mesh_indices.at(batch.mesh));
+            }
+
+            // batches sharing a material end up next to each other and can be drawn with one multi-draw, runs of
+            // materials sharing a pipeline with a single bind
+            std::vector<uint64_t> sort_keys;
+            sort_keys.reserve(m_draw_batches.size());
+            for (const auto& batch : m_draw_batches)
+                sort_keys.push_back(batch.sort_key);
+
+            const auto order = detail::radix_sort(sort_keys);
+
+            std::vector<detail::draw_batch> sorted_batches;
+            sorted_batches.reserve(m_draw_batches.size());
+            m_instances.reserve(scene.drawable_objects().size());
+
+            for (auto i : order) {
+                auto& batch = sorted_batches.emplace_back(m_draw_batches[i]);
+
+                batch.first_instance = m_instances.size();
+                batch.instance_count = batch_instances[i].size();
+                m_instances.append_range(batch_instances[i]);
+            }
+
+            m_draw_batches = std::move(sorted_batches);
+
+            const auto n_padded = (m_instances.size() + 3) & ~3ull;
+            for (auto array : {&m_cpu_culling.x, &m_cpu_culling.y, &m_cpu_culling.z, &m_cpu_culling.radius})
+                array->assign(n_padded, 0.0f);
+
+            m_cpu_culling.inside.assign(n_padded, 0);
+            m_cpu_culling.visible_counts.assign(m_draw_batches.size(), 0);
+
+            m_logger->debug("grouped {} drawable objects into {} draw batches ({} unique meshes, {} materials, {} pipelines)",
+                            m_instances.size(), m_draw_batches.size(), m_meshes.size(), m_materials.size(),
+                            m_pipelines.back().variant_count());
+
+            return {};
+        }
+    } // namespace engine
+} // namespace arbor
\ No newline at end of file
@@ -0,0 +1,67 @@
+#include "arbor/components/renderer.hpp"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define ARBOR_CULL_SSE
+#include <emmintrin.h>
+#endif
+
+namespace arbor {
+    namespace engine {
+        std::expected<void, std::string> renderer::cull_instances(uint32_t* visible) {
+            const auto planes = detail::frustum_planes(m_view_projection);
+            const auto n_instances = m_instances.size();
+            auto& inside = m_cpu_culling.inside;
+
+#ifdef ARBOR_CULL_SSE
+            // 4 spheres per iteration, a sphere is outside once it's entirely behind any of the planes
+            for (auto i = 0ull; i < n_instances; i += 4) {
+                const auto x = _mm_loadu_ps(&m_cpu_culling.x[i]);
+                const auto y = _mm_loadu_ps(&m_cpu_culling.y[i]);
+                const auto z = _mm_loadu_ps(&m_cpu_culling.z[i]);
+                const auto negative_radius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(&m_cpu_culling.radius[i]));
+
+                auto mask = _mm_castsi128_ps(_mm_set1_epi32(-1));
+                for (const auto& plane : planes) {
+                    auto distance = _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(plane.x)), _mm_set1_ps(plane.w));
+                    distance = _mm_add_ps(distance, _mm_mul_ps(y, _mm_set1_ps(plane.y)));
+                    distance = _mm_add_ps(distance, _mm_mul_ps(z, _mm_set1_ps(plane.z)));
+
+                    mask = _mm_and_ps(mask, _mm_cmpge_ps(distance, negative_radius));
+                }
+
+                const auto bits = _mm_movemask_ps(mask);
+                for (auto lane = 0; lane < 4; lane++)
+                    inside[i + lane] = (bits >> lane) & 1;
+            }
+#else
+            for (auto i = 0ull; i < n_instances; i++) {
+                inside[i] = 1;
+
+                for (const auto& plane : planes) {
+                    const auto distance = plane.x * m_cpu_culling.x[i] + plane.y * m_cpu_culling.y[i] +
+                                          plane.z * m_cpu_culling.z[i] + plane.w;
+
+                    if (distance < -m_cpu_culling.radius[i]) {
+                        inside[i] = 0;
+                        break;
+                    }
+                }
+            }
+#endif
+
+            // compact the surviving transform slots to the front of every batch's range
+            for (auto i = 0ull; i < m_draw_batches.size(); i++) {
+                const auto& batch = m_draw_batches[i];
+
+                auto count = 0u;
+                for (auto slot = batch.first_instance; slot < batch.first_instance + batch.instance_count; slot++)
+                    if (inside[slot])
+                        visible[batch.first_instance + count++] = slot;
+
+                m_cpu_culling.visible_counts[i] = count;
+            }
+
+            return {};
+        }
+    } // namespace engine
+} // namespace arbor
\ No newline at end of file
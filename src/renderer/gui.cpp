@@ -31,6 +31,7 @@ namespace arbor {
             init_info.Device = vk.device;
             init_info.QueueFamily = vk.physical_device.queue_family_indices.graphics_family;
             init_info.Queue = vk.graphics_queue;
+            init_info.PipelineCache = vk.pipeline_cache;
             init_info.DescriptorPoolSize = 1;
             init_info.Subpass = 0;
             init_info.MinImageCount = vk.sync.frames_in_flight;
@@ -49,7 +50,7 @@ namespace arbor {
             return {};
         }
 
-        std::expected<void, std::string> renderer::draw_gui() {
+        std::expected<void, std::string> renderer::draw_gui(VkCommandBuffer command_buffer) {
             static std::unordered_map<const char*, VkPresentModeKHR> present_modes = {
                 {"immediate", VK_PRESENT_MODE_IMMEDIATE_KHR},
                 {"mailbox", VK_PRESENT_MODE_MAILBOX_KHR},
@@ -96,6 +97,27 @@ namespace arbor {
             ImGui::Text("frames drawn: %llu", m_engine.frame_count());
             ImGui::Text("objects: %zu (%zu drawable)", m_engine.current_scene().objects().size(),
                         m_engine.current_scene().drawable_objects().size());
+            ImGui::Text("draw batches: %zu (%zu instances)", m_draw_batches.size(), m_instances.size());
+            ImGui::Text("recording threads: %u", vk.recording.n_threads);
+            ImGui::Text("binds: %u over %u draw packets (%u saved of %u with naive per-packet binding)",
+                        m_draw_statistics.binds, m_draw_statistics.packets,
+                        m_draw_statistics.naive_binds - m_draw_statistics.binds, m_draw_statistics.naive_binds);
+            ImGui::Text("gpu culling: %s (occlusion %s, compaction %s)", vk.config.gpu_culling ? "on" : "off",
+                        vk.config.occlusion_culling ? "on" : "off", vk.config.indirect_count ? "on" : "off");
+
+            {
+                auto heaps = vk.allocator.statistics();
+
+                for (auto i = 0ull; i < heaps.size(); i++) {
+                    if (!heaps[i].block_count)
+                        continue;
+
+                    ImGui::Text("heap %llu (%s): %.02f / %.02f MiB in %llu blocks (%llu allocations)", i,
+                                heaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT ? "device" : "host",
+                                heaps[i].bytes_used / 1048576.0, heaps[i].bytes_reserved / 1048576.0, heaps[i].block_count,
+                                heaps[i].allocation_count);
+                }
+            }
 
             ImGui::SeparatorText("info");
 
@@ -123,7 +145,7 @@ namespace arbor {
             }
 
             if (ImGui::Combo("MSAA", &current_msaa_config_idx, msaa_options, IM_ARRAYSIZE(msaa_options))) {
-                vk.config.sample_count = msaa_sample_counts[msaa_options[current_present_mode_idx]];
+                vk.config.sample_count = msaa_sample_counts[msaa_options[current_msaa_config_idx]];
                 vk.deferred_swapchain_reload = true;
             }
 
@@ -137,7 +159,7 @@ namespace arbor {
             ImGui::End();
 
             ImGui::Render();
-            ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), vk.command_buffers[vk.sync.current_frame]);
+            ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), command_buffer);
             return {};
         }
     } // namespace engine
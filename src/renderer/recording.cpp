@@ -0,0 +1,176 @@
+#include "arbor/components/renderer.hpp"
+
+#include "vulkan/vk_enum_string_helper.h"
+
+#include <algorithm>
+
+namespace arbor {
+    namespace engine {
+        std::expected<void, std::string> renderer::record_secondary_command_buffers(const VkRenderPassBeginInfo& render_pass) {
+            const auto frame = vk.sync.current_frame;
+            const auto n_threads = vk.recording.n_threads;
+            const auto n_batches = m_draw_batches.size();
+
+            // the frame's fence has been waited on, nothing allocated from its pools is in use anymore
+            for (auto i = 0u; i < n_threads; i++)
+                vkResetCommandPool(vk.device, vk.recording.pools[frame * n_threads + i], 0);
+
+            const auto n_chunks = static_cast<uint32_t>(
+                std::clamp<uint64_t>(n_batches / vk.recording.min_batches_per_thread, 1, n_threads));
+
+            // chunks only ever start on a material run, a compacted run's draw count can't be split between buffers
+            std::vector<uint64_t> chunk_starts(n_chunks + 1, n_batches);
+            chunk_starts.front() = 0;
+
+            for (auto first = 0ull, chunk = 0ull; first < n_batches;) {
+                auto last = first;
+                while (last < n_batches && m_draw_batches[last].material_set == m_draw_batches[first].material_set)
+                    last++;
+
+                while (chunk + 1 < n_chunks && first >= (chunk + 1) * n_batches / n_chunks)
+                    chunk_starts[++chunk] = first;
+
+                first = last;
+            }
+
+            VkCommandBufferInheritanceInfo inheritance_info{};
+            inheritance_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+            inheritance_info.renderPass = render_pass.renderPass;
+            inheritance_info.subpass = 0;
+            inheritance_info.framebuffer = render_pass.framebuffer;
+
+            VkCommandBufferBeginInfo begin_info{};
+            begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+            begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+            begin_info.pInheritanceInfo = &inheritance_info;
+
+            std::vector<VkResult> results(n_chunks, VK_SUCCESS);
+            std::vector<detail::bind_state> states(n_chunks);
+
+            const auto record_chunk = [&](uint32_t chunk) {
+                auto command_buffer = vk.recording.draw_buffers[frame * n_threads + chunk];
+
+                if (results[chunk] = vkBeginCommandBuffer(command_buffer, &begin_info); results[chunk] != VK_SUCCESS)
+                    return;
+
+                record_draws(command_buffer, states[chunk], chunk_starts[chunk], chunk_starts[chunk + 1]);
+                results[chunk] = vkEndCommandBuffer(command_buffer);
+            };
+
+            std::vector<job_system::handle> jobs;
+            jobs.reserve(n_chunks - 1);
+
+            for (auto chunk = 1u; chunk < n_chunks; chunk++)
+                jobs.push_back(m_engine.jobs().submit([&record_chunk, chunk] { record_chunk(chunk); }));
+
+            // the gui can only be built on this thread, it's recorded while the workers go through the other chunks
+            auto gui_buffer = vk.recording.gui_buffers[frame];
+            auto gui_result = vkBeginCommandBuffer(gui_buffer, &begin_info);
+            if (gui_result == VK_SUCCESS) {
+                draw_gui(gui_buffer);
+                gui_result = vkEndCommandBuffer(gui_buffer);
+            }
+
+            record_chunk(0);
+            m_engine.jobs().wait(jobs);
+
+            if (gui_result != VK_SUCCESS)
+                return std::unexpected(fmt::format("failed to record a command buffer: {}", string_VkResult(gui_result)));
+
+            m_draw_statistics = {};
+            for (const auto& state : states) {
+                m_draw_statistics.packets += state.packets;
+                m_draw_statistics.binds += state.binds;
+            }
+
+            m_draw_statistics.naive_binds = m_draw_statistics.packets * detail::bind_state::binds_per_packet;
+
+            std::vector<VkCommandBuffer> secondary_buffers;
+            secondary_buffers.reserve(n_chunks + 1);
+
+            for (auto chunk = 0u; chunk < n_chunks; chunk++) {
+                if (results[chunk] != VK_SUCCESS)
+                    return std::unexpected(fmt::format("failed to record a command buffer: {}", string_VkResult(results[chunk])));
+
+                secondary_buffers.push_back(vk.recording.draw_buffers[frame * n_threads + chunk]);
+            }
+
+            secondary_buffers.push_back(gui_buffer);
+
+            vkCmdExecuteCommands(vk.command_buffers[frame], secondary_buffers.size(), secondary_buffers.data());
+
+            return {};
+        }
+
+        void renderer::record_draws(VkCommandBuffer command_buffer, detail::bind_state& state, uint64_t first_batch,
+                                    uint64_t last_batch) {
+            vkCmdSetViewport(command_buffer, 0, 1, m_pipelines.back().viewports());
+            vkCmdSetScissor(command_buffer, 0, 1, m_pipelines.back().scissors());
+
+            std::array<uint32_t, 3> frame_offsets = {
+                static_cast<uint32_t>(vk.sync.current_frame * vk.frame_ring_frame_size),
+                static_cast<uint32_t>(vk.sync.current_frame * vk.frame_ring_frame_size + vk.frame_ring_camera_size),
+                static_cast<uint32_t>(vk.sync.current_frame * vk.frame_ring_frame_size + vk.frame_ring_camera_size +
+                                      vk.frame_ring_transforms_size),
+            };
+
+            // every variant shares the layout, so the frame set stays bound across pipeline binds
+            vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelines.back().m_pipeline_layout, 0, 1,
+                                    &m_pipelines.back().m_frame_descriptor_set, frame_offsets.size(), frame_offsets.data());
+
+            const auto indirect_offset = vk.sync.current_frame * vk.indirect_frame_size;
+            const auto multi_draw = vk.physical_device.features.multiDrawIndirect;
+
+            // batches are sorted by pipeline and then material, so every run of batches sharing a material is a
+            // single multi-draw and a pipeline is only bound when the run after it needs a different one
+            for (auto first = first_batch; first < last_batch;) {
+                auto last = first;
+                while (last < last_batch && m_draw_batches[last].material_set == m_draw_batches[first].material_set)
+                    last++;
+
+                // materials whose pipeline isn't built for the current render pass yet are skipped until it is
+                const auto pipeline = m_draw_batches[first].pipeline;
+                if (!m_pipelines.back().ready(pipeline)) {
+                    first = last;
+                    continue;
+                }
+
+                // every run asks for the whole state it's drawn with, only what differs from the last run is bound
+                state.bind_geometry(command_buffer, *vk.vertex_buffer.buffer(), *vk.index_buffer.buffer());
+                state.bind_pipeline(command_buffer, m_pipelines.back().pipeline_handle(pipeline));
+                state.bind_material_set(command_buffer, m_pipelines.back().m_pipeline_layout,
+                                        m_pipelines.back().m_material_descriptor_sets[m_draw_batches[first].material_set]);
+                state.packets += last - first;
+
+                if (vk.config.gpu_culling && vk.config.indirect_count) {
+                    // the cull shader appended every batch with visible instances to its material's compacted run
+                    vkCmdDrawIndexedIndirectCount(command_buffer, *vk.indirect_buffer.buffer(),
+                                                  indirect_offset + vk.indirect_compacted_offset +
+                                                      first * sizeof(VkDrawIndexedIndirectCommand),
+                                                  *vk.indirect_buffer.buffer(),
+                                                  indirect_offset + vk.indirect_counts_offset +
+                                                      m_draw_batches[first].material_set * sizeof(uint32_t),
+                                                  last - first, sizeof(VkDrawIndexedIndirectCommand));
+                } else if (vk.config.indirect_draws && multi_draw) {
+                    vkCmdDrawIndexedIndirect(command_buffer, *vk.indirect_buffer.buffer(),
+                                             indirect_offset + first * sizeof(VkDrawIndexedIndirectCommand), last - first,
+                                             sizeof(VkDrawIndexedIndirectCommand));
+                } else {
+                    for (auto i = first; i < last; i++) {
+                        const auto& batch = m_draw_batches[i];
+
+                        if (vk.config.indirect_draws)
+                            vkCmdDrawIndexedIndirect(command_buffer, *vk.indirect_buffer.buffer(),
+                                                     indirect_offset + i * sizeof(VkDrawIndexedIndirectCommand), 1,
+                                                     sizeof(VkDrawIndexedIndirectCommand));
+                        else
+                            vkCmdDrawIndexed(command_buffer, batch.index_count, m_cpu_culling.visible_counts[i],
+                                             batch.first_index, batch.vertex_offset, batch.first_instance);
+                    }
+                }
+
+                first = last;
+            }
+        }
+    } // namespace engine
+} // namespace arbor
\ No newline at end of file
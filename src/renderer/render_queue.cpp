@@ -0,0 +1,70 @@
+#include "arbor/components/renderer.hpp"
+
+#include <numeric>
+
+namespace arbor {
+    namespace engine {
+        std::vector<uint32_t> detail::radix_sort(std::span<const uint64_t> keys) {
+            std::vector<uint32_t> order(keys.size());
+            std::iota(order.begin(), order.end(), 0u);
+
+            if (keys.size() < 2)
+                return order;
+
+            std::vector<uint32_t> scattered(keys.size());
+
+            for (auto shift = 0u; shift < 64; shift += 8) {
+                std::array<uint32_t, 256> offsets{};
+                for (auto key : keys)
+                    offsets[(key >> shift) & 0xff]++;
+
+                if (offsets[(keys.front() >> shift) & 0xff] == keys.size())
+                    continue;
+
+                std::exclusive_scan(offsets.begin(), offsets.end(), offsets.begin(), 0u);
+
+                // the previous digits' order is kept within every bucket, that's what makes the passes add up
+                for (auto index : order)
+                    scattered[offsets[(keys[index] >> shift) & 0xff]++] = index;
+
+                order.swap(scattered);
+            }
+
+            return order;
+        }
+
+        void detail::bind_state::bind_pipeline(VkCommandBuffer command_buffer, VkPipeline handle) {
+            if (pipeline == handle)
+                return;
+
+            vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, handle);
+            pipeline = handle;
+            binds++;
+        }
+
+        void detail::bind_state::bind_material_set(VkCommandBuffer command_buffer, VkPipelineLayout layout,
+                                                   VkDescriptorSet set) {
+            if (material_set == set)
+                return;
+
+            vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, layout, 1, 1, &set, 0, nullptr);
+            material_set = set;
+            binds++;
+        }
+
+        void detail::bind_state::bind_geometry(VkCommandBuffer command_buffer, VkBuffer vertices, VkBuffer indices) {
+            if (vertex_buffer != vertices) {
+                VkDeviceSize offset = 0;
+                vkCmdBindVertexBuffers(command_buffer, 0, 1, &vertices, &offset);
+                vertex_buffer = vertices;
+                binds++;
+            }
+
+            if (index_buffer != indices) {
+                vkCmdBindIndexBuffer(command_buffer, indices, 0, VK_INDEX_TYPE_UINT32);
+                index_buffer = indices;
+                binds++;
+            }
+        }
+    } // namespace engine
+} // namespace arbor
\ No newline at end of file
@@ -12,6 +12,7 @@
 #include "imgui_impl_sdl3.h"
 #include "imgui_impl_vulkan.h"
 #include <algorithm>
+#include <cstring>
 #include <vulkan/vulkan_core.h>
 
 namespace arbor {
@@ -25,10 +26,16 @@ namespace arbor {
             if (vk.device)
                 vkDeviceWaitIdle(vk.device);
 
+            for (auto frame = 0u; frame < m_retired.size(); frame++)
+                release_retired(frame);
+
             vk.index_buffer.free();
             vk.vertex_buffer.free();
-            vk.uniform_buffers.clear();
+            vk.frame_ring.free();
+            vk.indirect_buffer.free();
 
+            m_culling.destroy();
+            m_uploads.destroy();
             m_pipelines.clear();
             m_textures.clear();
 
@@ -54,6 +61,12 @@ namespace arbor {
                 vk.command_pool = VK_NULL_HANDLE;
             }
 
+            for (auto& pool : vk.recording.pools) {
+                if (pool && vk.device)
+                    vkDestroyCommandPool(vk.device, pool, nullptr);
+                pool = VK_NULL_HANDLE;
+            }
+
             for (auto& framebuffer : vk.swapchain.framebuffers) {
                 if (framebuffer && vk.device)
                     vkDestroyFramebuffer(vk.device, framebuffer, nullptr);
@@ -76,10 +89,7 @@ namespace arbor {
                 vk.swapchain.depth_image = VK_NULL_HANDLE;
             }
 
-            if (vk.swapchain.depth_buffer && vk.device) {
-                vkFreeMemory(vk.device, vk.swapchain.depth_buffer, nullptr);
-                vk.swapchain.depth_buffer = VK_NULL_HANDLE;
-            }
+            vk.allocator.free(vk.swapchain.depth_buffer);
 
             if (vk.swapchain.msaa_image_view && vk.device) {
                 vkDestroyImageView(vk.device, vk.swapchain.msaa_image_view, nullptr);
@@ -91,10 +101,7 @@ namespace arbor {
                 vk.swapchain.msaa_image = VK_NULL_HANDLE;
             }
 
-            if (vk.swapchain.msaa_image_buffer && vk.device) {
-                vkFreeMemory(vk.device, vk.swapchain.msaa_image_buffer, nullptr);
-                vk.swapchain.msaa_image_buffer = VK_NULL_HANDLE;
-            }
+            vk.allocator.free(vk.swapchain.msaa_image_buffer);
 
             if (vk.swapchain.handle && vk.device) {
                 vkDestroySwapchainKHR(vk.device, vk.swapchain.handle, nullptr);
@@ -110,6 +117,16 @@ namespace arbor {
             ImGui_ImplSDL3_Shutdown();
             ImGui::DestroyContext(m_gui.imgui_ctx);
 
+            if (auto res = save_vk_pipeline_cache(); !res)
+                m_logger->warn("{}", res.error());
+
+            if (vk.pipeline_cache && vk.device) {
+                vkDestroyPipelineCache(vk.device, vk.pipeline_cache, nullptr);
+                vk.pipeline_cache = VK_NULL_HANDLE;
+            }
+
+            vk.allocator.destroy();
+
             if (vk.device) {
                 vkDestroyDevice(vk.device, nullptr);
                 vk.device = VK_NULL_HANDLE;
@@ -142,24 +159,47 @@ namespace arbor {
             if (auto res = make_vk_device(); !res)
                 return res;
 
-            if (auto res = make_vertex_buffer(); !res)
+            if (auto res = make_vk_pipeline_cache(); !res)
+                return res;
+
+            if (auto res = m_uploads.init(); !res)
                 return res;
 
-            if (auto res = make_index_buffer(); !res)
+            // batches pick their pipeline variants while they're built, the pipeline has to exist before them
+            if (auto res = make_vk_pipeline(); !res)
+                return res;
+
+            m_retired.resize(vk.sync.frames_in_flight);
+            m_built_scene = &m_engine.current_scene();
+            m_engine.current_scene().take_dirty();
+
+            if (auto res = build_draw_batches(); !res)
+                return res;
+
+            if (auto res = upload_meshes(); !res)
                 return res;
 
             if (auto res = make_uniform_buffers(); !res)
                 return res;
 
+            if (auto res = make_indirect_buffer(); !res)
+                return res;
+
             if (auto res = make_vk_command_pool_and_buffers(); !res)
                 return res;
 
             if (auto res = load_assets(); !res)
                 return res;
 
+            if (auto res = m_culling.make_pipelines(); !res)
+                return res;
+
             if (auto res = make_vk_swapchain_and_pipeline(); !res)
                 return res;
 
+            if (auto res = m_culling.make_descriptor_sets(); !res)
+                return res;
+
             if (auto res = make_sync_objects(); !res)
                 return res;
 
@@ -171,6 +211,8 @@ namespace arbor {
 
         std::expected<void, std::string> renderer::update() {
             vkWaitForFences(vk.device, 1, &vk.sync.in_flight_fences[vk.sync.current_frame], VK_TRUE, uint64_t(-1));
+            release_retired(vk.sync.current_frame);
+            m_uploads.collect();
 
             if (vk.deferred_swapchain_reload) {
                 if (auto res = reload_swapchain(); !res)
@@ -179,11 +221,21 @@ namespace arbor {
             }
 
             if (vk.deferred_scene_reload) {
-                if (auto res = reload_scene(); !res)
+                if (auto res = apply_scene_changes(); !res)
                     return res;
                 vk.deferred_scene_reload = false;
             }
 
+            if (vk.config.shader_hot_reload)
+                reload_changed_shaders();
+
+            if (auto res = m_pipelines.back().poll_builds(); !res)
+                return res;
+
+            // everything uploaded while applying changes goes out in one submission, the frame waits on it
+            if (auto res = m_uploads.flush(); !res)
+                return res;
+
             auto image_idx = acquire_image();
             if (!image_idx)
                 return std::unexpected(image_idx.error());
@@ -242,6 +294,17 @@ namespace arbor {
             if (auto res = vkBeginCommandBuffer(current_cmd_buf, &cmd_buffer_begin_info); res != VK_SUCCESS)
                 return std::unexpected(fmt::format("failed to begin recording a command buffer: {}", string_VkResult(res)));
 
+            m_uploads.record_mip_chains(current_cmd_buf);
+
+            if (auto res = update_ubos(); !res)
+                return res;
+
+            if (auto res = update_draw_commands(); !res)
+                return res;
+
+            if (auto res = m_culling.record(current_cmd_buf); !res)
+                return res;
+
             render_pass_begin_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
             render_pass_begin_info.renderPass = m_pipelines.back().render_pass();
             render_pass_begin_info.framebuffer = vk.swapchain.framebuffers[vk.swapchain.current_image];
@@ -249,34 +312,12 @@ namespace arbor {
             render_pass_begin_info.clearValueCount = clear_values.size();
             render_pass_begin_info.pClearValues = clear_values.data();
 
-            vkCmdBeginRenderPass(current_cmd_buf, &render_pass_begin_info, VK_SUBPASS_CONTENTS_INLINE);
-
-            vkCmdBindPipeline(current_cmd_buf, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelines.back().pipeline_handle());
-
-            VkDeviceSize offset = 0;
-            vkCmdBindVertexBuffers(current_cmd_buf, 0, 1, vk.vertex_buffer.buffer(), &offset);
-            vkCmdBindIndexBuffer(current_cmd_buf, *vk.index_buffer.buffer(), 0, VK_INDEX_TYPE_UINT32);
-
-            vkCmdSetViewport(current_cmd_buf, 0, 1, m_pipelines.back().viewports());
-            vkCmdSetScissor(current_cmd_buf, 0, 1, m_pipelines.back().scissors());
+            vkCmdBeginRenderPass(current_cmd_buf, &render_pass_begin_info, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
 
-            update_ubos();
-
-            uint32_t index_offset = 0;
-            uint32_t vertex_offset = 0;
-            uint32_t ubo_offset = 0;
-            for (auto& id : m_engine.current_scene().drawable_objects()) {
-                vkCmdBindDescriptorSets(current_cmd_buf, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelines.back().m_pipeline_layout, 0,
-                                        1, &m_pipelines.back().m_descriptor_sets[vk.sync.current_frame + ubo_offset], 0, nullptr);
-                vkCmdDrawIndexed(current_cmd_buf, m_engine.current_scene().asset_library()[id].model.indices.size(), 1,
-                                 index_offset, vertex_offset, 0);
-
-                index_offset += m_engine.current_scene().asset_library()[id].model.indices.size();
-                vertex_offset += m_engine.current_scene().asset_library()[id].model.vertices.size();
-                ubo_offset += vk.sync.frames_in_flight;
-            }
+            if (auto res = record_secondary_command_buffers(render_pass_begin_info); !res)
+                return res;
 
-            draw_gui();
+            m_culling.m_depth_valid = true;
 
             return {};
         }
@@ -288,11 +329,26 @@ namespace arbor {
                 return std::unexpected(fmt::format("failed to record a command buffer: {}", string_VkResult(res)));
 
             VkSubmitInfo submit_info{};
-            VkPipelineStageFlags wait_stages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
+            VkTimelineSemaphoreSubmitInfo timeline_info{};
+
+            // the upload timeline is only waited on when there were uploads since the last frame, the value is ignored
+            // for the binary acquire semaphore
+            const auto upload_value = m_uploads.take_wait_value();
+            VkSemaphore wait_semaphores[] = {vk.sync.wait_semaphores[vk.sync.current_frame], m_uploads.timeline()};
+            uint64_t wait_values[] = {0, upload_value};
+            VkPipelineStageFlags wait_stages[] = {
+                VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+            };
+
+            timeline_info.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+            timeline_info.waitSemaphoreValueCount = upload_value ? 2 : 1;
+            timeline_info.pWaitSemaphoreValues = wait_values;
 
             submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-            submit_info.waitSemaphoreCount = 1;
-            submit_info.pWaitSemaphores = &vk.sync.wait_semaphores[vk.sync.current_frame];
+            submit_info.pNext = &timeline_info;
+            submit_info.waitSemaphoreCount = upload_value ? 2 : 1;
+            submit_info.pWaitSemaphores = wait_semaphores;
             submit_info.commandBufferCount = 1;
             submit_info.pCommandBuffers = &vk.command_buffers[vk.sync.current_frame];
             submit_info.signalSemaphoreCount = 1;
@@ -332,19 +388,76 @@ namespace arbor {
         }
 
         std::expected<void, std::string> renderer::update_ubos() {
-            static engine::detail::mvp mvp;
-            mvp.view = m_engine.current_scene().camera().view_matrix();
+            engine::detail::camera_data camera;
+            camera.view = m_engine.current_scene().camera().view_matrix();
 
-            mvp.projection =
+            camera.projection =
                 glm::perspective(glm::radians(75.0f),
                                  static_cast<float32_t>(m_engine.window().width()) / m_engine.window().height(), 1e-6f, 1e+6f);
-            mvp.projection[1][1] *= -1.0;
+            camera.projection[1][1] *= -1.0;
 
-            uint32_t ubo_offset = 0;
-            for (auto& id : m_engine.current_scene().drawable_objects()) {
-                mvp.model = m_engine.current_scene().objects()[id].transform();
-                vk.uniform_buffers[vk.sync.current_frame + ubo_offset].write_data(&mvp, sizeof(mvp));
-                ubo_offset += vk.sync.frames_in_flight;
+            m_view_projection = camera.projection * camera.view;
+
+            // the current frame's region of the ring is not in use by the GPU anymore, its fence has been waited on
+            auto region = static_cast<uint8_t*>(vk.frame_ring.mapped()) + vk.sync.current_frame * vk.frame_ring_frame_size;
+            std::memcpy(region, &camera, sizeof(camera));
+
+            const auto& object_transforms = m_engine.current_scene().objects().transforms();
+
+            auto transforms = reinterpret_cast<glm::mat4*>(region + vk.frame_ring_camera_size);
+            if (vk.config.gpu_culling) {
+                for (auto index : m_instances)
+                    *transforms++ = object_transforms[index];
+
+                return {};
+            }
+
+            // without the culling stage the world space bounds are gathered here, while the transforms are at hand
+            for (const auto& batch : m_draw_batches) {
+                const auto local_radius = batch.bounds.w;
+                const auto local_center = glm::vec4(glm::vec3(batch.bounds), 1.0f);
+
+                for (auto i = batch.first_instance; i < batch.first_instance + batch.instance_count; i++) {
+                    const auto& transform = object_transforms[m_instances[i]];
+                    transforms[i] = transform;
+
+                    const auto center = transform * local_center;
+                    const auto scale = std::max({glm::length(glm::vec3(transform[0])), glm::length(glm::vec3(transform[1])),
+                                                 glm::length(glm::vec3(transform[2]))});
+
+                    m_cpu_culling.x[i] = center.x;
+                    m_cpu_culling.y[i] = center.y;
+                    m_cpu_culling.z[i] = center.z;
+                    m_cpu_culling.radius[i] = local_radius * scale;
+                }
+            }
+
+            auto visible = reinterpret_cast<uint32_t*>(region + vk.frame_ring_camera_size + vk.frame_ring_transforms_size);
+            return cull_instances(visible);
+        }
+
+        std::expected<void, std::string> renderer::update_draw_commands() {
+            auto commands = reinterpret_cast<VkDrawIndexedIndirectCommand*>(static_cast<uint8_t*>(vk.indirect_buffer.mapped()) +
+                                                                            vk.sync.current_frame * vk.indirect_frame_size);
+
+            // every instance picks its slot in the transform stream up through gl_InstanceIndex.
+            // with gpu culling the instance counts start at zero and are filled in by the cull shader
+            for (auto i = 0ull; i < m_draw_batches.size(); i++) {
+                const auto& batch = m_draw_batches[i];
+
+                *commands++ = {
+                    .indexCount = batch.index_count,
+                    .instanceCount = vk.config.gpu_culling ? 0 : m_cpu_culling.visible_counts[i],
+                    .firstIndex = batch.first_index,
+                    .vertexOffset = batch.vertex_offset,
+                    .firstInstance = batch.first_instance,
+                };
+            }
+
+            if (vk.config.gpu_culling) {
+                auto counts = static_cast<uint8_t*>(vk.indirect_buffer.mapped()) +
+                              vk.sync.current_frame * vk.indirect_frame_size + vk.indirect_counts_offset;
+                std::memset(counts, 0, m_materials.size() * sizeof(uint32_t));
             }
 
             return {};
@@ -356,21 +469,43 @@ namespace arbor {
         };
 
         std::expected<void, std::string> renderer::reload_scene() {
+            // copies into the buffers that are about to be freed can't be left unsubmitted
+            if (auto res = m_uploads.flush(); !res)
+                return res;
+
             vkDeviceWaitIdle(vk.device);
 
+            for (auto frame = 0u; frame < m_retired.size(); frame++)
+                release_retired(frame);
+            m_uploads.collect();
+
             vk.index_buffer.free();
             vk.vertex_buffer.free();
-            vk.uniform_buffers.clear();
+            vk.frame_ring.free();
+            vk.indirect_buffer.free();
+
+            m_meshes.clear();
+            m_mesh_ranges.clear();
+            m_geometry = {};
 
-            if (auto res = make_vertex_buffer(); !res)
+            m_built_scene = &m_engine.current_scene();
+            m_engine.current_scene().take_dirty();
+
+            if (auto res = build_draw_batches(); !res)
                 return res;
 
-            if (auto res = make_index_buffer(); !res)
+            if (auto res = upload_meshes(); !res)
                 return res;
 
             if (auto res = make_uniform_buffers(); !res)
                 return res;
 
+            if (auto res = make_indirect_buffer(); !res)
+                return res;
+
+            if (auto res = m_culling.make_descriptor_sets(); !res)
+                return res;
+
             if (auto res = load_assets(); !res)
                 return res;
 
@@ -379,5 +514,57 @@ namespace arbor {
 
             return {};
         };
+
+        std::expected<void, std::string> renderer::apply_scene_changes() {
+            if (m_built_scene != &m_engine.current_scene())
+                return reload_scene();
+
+            if (!m_engine.current_scene().take_dirty())
+                return {};
+
+            m_logger->debug("applying scene changes");
+
+            // batches and instance indices are rebuilt on the CPU. meshes that were placed before keep their ranges and
+            // textures stay loaded, only new ones are uploaded. nothing the frames in flight still use is written to,
+            // replaced resources are retired instead
+            const auto previous_materials = m_materials;
+            auto frame_ring_replaced = false;
+
+            if (auto res = build_draw_batches(); !res)
+                return res;
+
+            if (auto res = upload_meshes(); !res)
+                return res;
+
+            if (m_engine.current_scene().drawable_objects().size() > vk.frame_ring_capacity) {
+                retire(vk.frame_ring.release());
+                frame_ring_replaced = true;
+
+                if (auto res = make_uniform_buffers(); !res)
+                    return res;
+            }
+
+            if (m_draw_batches.size() > vk.indirect_batch_capacity || m_materials.size() > vk.indirect_material_capacity) {
+                retire(vk.indirect_buffer.release());
+
+                if (auto res = make_indirect_buffer(); !res)
+                    return res;
+            }
+
+            if (auto res = load_assets(); !res)
+                return res;
+
+            // the sets only point at the frame ring and the materials' textures. when either changed, fresh ones are
+            // allocated from a new pool since the old ones may be bound by frames in flight
+            if (frame_ring_replaced || m_materials != previous_materials) {
+                if (auto res = m_pipelines.back().make_vk_descriptor_pool_and_sets(); !res)
+                    return res;
+            }
+
+            if (auto res = m_culling.make_descriptor_sets(); !res)
+                return res;
+
+            return {};
+        }
     } // namespace engine
 } // namespace arbor
\ No newline at end of file
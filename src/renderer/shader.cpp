@@ -3,6 +3,8 @@
 #include <fstream>
 #include <iterator>
 
+#include "arbor/hash.hpp"
+
 #include "shaderc/shaderc.h"
 #include "shaderc/shaderc.hpp"
 #include "shaderc/status.h"
@@ -16,32 +18,162 @@ namespace arbor {
                 vkDestroyShaderModule(m_vk_device, m_vk_shader, nullptr);
         }
 
-        std::expected<void, std::string> renderer::shader::compile() {
+        renderer::shader renderer::shader::from_glsl(const std::string& name, std::string glsl, shader::etype type,
+                                                     VkDevice device) {
+            shader embedded(name, type, device);
+            embedded.m_glsl = std::move(glsl);
+            embedded.m_embedded = true;
+
+            return embedded;
+        }
+
+        namespace {
+            struct spirv_cache_header {
+                uint32_t magic;
+                uint32_t word_count;
+                uint64_t hash;
+            };
+
+            constexpr uint32_t spirv_cache_magic = 0x53565241; // "ARVS"
+            constexpr uint32_t spirv_cache_version = 1;
+
+#ifdef NDEBUG
+            constexpr auto optimization_level = shaderc_optimization_level_performance;
+#else
+            constexpr auto optimization_level = shaderc_optimization_level_zero;
+#endif
+
+            // shaderc can't report its version, so the compiler is identified by what it makes of a fixed shader. the
+            // generator word of the SPIR-V header carries glslang's version, changes to code generation show in the body
+            uint64_t compiler_fingerprint() {
+                static const auto fingerprint = [] {
+                    constexpr auto glsl = R"(#version 450
+layout(local_size_x = 64) in;
+layout(std430, binding = 0) buffer data { float values[]; };
+
+void main() {
+    float sum = 0.0;
+    for (int i = 0; i < 4; i++)
+        sum += sin(values[gl_GlobalInvocationID.x + i]) * float(i);
+
+    values[gl_GlobalInvocationID.x] = sum;
+}
+)";
+
+                    shaderc::Compiler compiler;
+                    shaderc::CompileOptions options;
+                    options.SetOptimizationLevel(optimization_level);
+
+                    auto res = compiler.CompileGlslToSpv(glsl, shaderc_compute_shader, "fingerprint", options);
+                    const std::vector<uint32_t> spv(res.begin(), res.end());
+
+                    return hash_bytes(spv.data(), spv.size() * sizeof(uint32_t));
+                }();
+
+                return fingerprint;
+            }
+
+            std::vector<uint32_t> read_cached_spirv(const std::filesystem::path& path) {
+                std::error_code error;
+                const auto file_size = std::filesystem::file_size(path, error);
+                if (error)
+                    return {};
+
+                std::ifstream stream(path, std::ios::binary);
+                if (!stream)
+                    return {};
+
+                spirv_cache_header header{};
+                if (!stream.read(reinterpret_cast<char*>(&header), sizeof(header)) || header.magic != spirv_cache_magic)
+                    return {};
+
+                // the word count of a truncated or damaged entry can be anything, it has to match the file first
+                if (file_size != sizeof(header) + uint64_t(header.word_count) * sizeof(uint32_t))
+                    return {};
+
+                std::vector<uint32_t> spv(header.word_count);
+                if (!stream.read(reinterpret_cast<char*>(spv.data()), spv.size() * sizeof(uint32_t)))
+                    return {};
+
+                // a truncated or damaged entry is just compiled again
+                if (header.hash != hash_bytes(spv.data(), spv.size() * sizeof(uint32_t)))
+                    return {};
+
+                return spv;
+            }
+
+            void write_cached_spirv(const std::filesystem::path& path, const std::vector<uint32_t>& spv) {
+                std::error_code error;
+                std::filesystem::create_directories(path.parent_path(), error);
+
+                auto temporary = path;
+                temporary += ".tmp";
+
+                const spirv_cache_header header = {
+                    .magic = spirv_cache_magic,
+                    .word_count = static_cast<uint32_t>(spv.size()),
+                    .hash = hash_bytes(spv.data(), spv.size() * sizeof(uint32_t)),
+                };
+
+                {
+                    std::ofstream stream(temporary, std::ios::binary | std::ios::trunc);
+                    stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+                    stream.write(reinterpret_cast<const char*>(spv.data()), spv.size() * sizeof(uint32_t));
+
+                    if (!stream)
+                        return;
+                }
+
+                std::filesystem::rename(temporary, path, error);
+            }
+        } // namespace
+
+        std::expected<void, std::string> renderer::shader::compile(const std::filesystem::path& cache_directory) {
             shaderc::Compiler compiler;
             shaderc::CompileOptions options;
 
-            std::ifstream stream(m_source, std::ios::binary);
-            if (!stream)
-                return std::unexpected(fmt::format("failed to open shader source: {}", std::strerror(errno)));
+            if (!m_embedded) {
+                std::ifstream stream(m_source, std::ios::binary);
+                if (!stream)
+                    return std::unexpected(fmt::format("failed to open shader source: {}", std::strerror(errno)));
 
-            m_glsl = {std::istreambuf_iterator(stream), std::istreambuf_iterator<char>()};
+                m_glsl = {std::istreambuf_iterator(stream), std::istreambuf_iterator<char>()};
+            }
 
             static std::unordered_map<shader::etype, shaderc_shader_kind> type_translation_map = {
                 {etype::vertex, shaderc_vertex_shader},
                 {etype::fragment, shaderc_fragment_shader},
+                {etype::compute, shaderc_compute_shader},
             };
 
-#ifdef NDEBUG
-            options.SetOptimizationLevel(shaderc_optimization_level_performance);
-#else
-            options.SetOptimizationLevel(shaderc_optimization_level_zero);
-#endif
+            options.SetOptimizationLevel(optimization_level);
+
+            // no includer is set up, so the source alone is everything the compiler sees. the key covers everything
+            // else that changes the output, down to the build of the compiler
+            auto key = hash_string(m_glsl);
+            for (uint64_t value :
+                 {uint64_t(m_type), uint64_t(optimization_level), compiler_fingerprint(), uint64_t(spirv_cache_version)})
+                key = hash_combine(key, value);
+
+            const auto cache_path = cache_directory.empty()
+                                        ? std::filesystem::path()
+                                        : cache_directory / fmt::format("{:016x}.spv", key);
+
+            m_spv.clear();
+            if (!cache_path.empty())
+                m_spv = read_cached_spirv(cache_path);
+
+            if (m_spv.empty()) {
+                auto res =
+                    compiler.CompileGlslToSpv(m_glsl, type_translation_map[m_type], m_source.string().c_str(), options);
+                if (res.GetCompilationStatus() != shaderc_compilation_status_success)
+                    return std::unexpected(res.GetErrorMessage());
 
-            auto res = compiler.CompileGlslToSpv(m_glsl, type_translation_map[m_type], m_source.string().c_str());
-            if (res.GetCompilationStatus() != shaderc_compilation_status_success)
-                return std::unexpected(res.GetErrorMessage());
+                m_spv = {res.begin(), res.end()};
 
-            m_spv = {res.begin(), res.end()};
+                if (!cache_path.empty())
+                    write_cached_spirv(cache_path, m_spv);
+            }
 
             VkShaderModuleCreateInfo create_info{};
 
@@ -59,6 +191,7 @@ namespace arbor {
             static std::unordered_map<shader::etype, VkShaderStageFlagBits> type_translation_map = {
                 {etype::vertex, VK_SHADER_STAGE_VERTEX_BIT},
                 {etype::fragment, VK_SHADER_STAGE_FRAGMENT_BIT},
+                {etype::compute, VK_SHADER_STAGE_COMPUTE_BIT},
             };
             return type_translation_map[m_type];
         }
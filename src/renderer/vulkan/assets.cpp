@@ -2,30 +2,109 @@
 
 #include "fmt/format.h"
 #include "vulkan/vk_enum_string_helper.h"
+#include <algorithm>
+#include <bit>
+#include <numeric>
 #include <vulkan/vulkan_core.h>
 
 namespace arbor {
     namespace engine {
+        namespace {
+            VkFormat texture_format(assets::texture::eformat format) {
+                switch (format) {
+                case assets::texture::eformat::bc1: return VK_FORMAT_BC1_RGBA_UNORM_BLOCK;
+                case assets::texture::eformat::bc3: return VK_FORMAT_BC3_UNORM_BLOCK;
+                case assets::texture::eformat::bc7: return VK_FORMAT_BC7_UNORM_BLOCK;
+                default: return VK_FORMAT_R8G8B8A8_UNORM;
+                }
+            }
+
+            // compressed formats the device can sample with linear filtering
+            std::vector<assets::texture::eformat> compressed_texture_formats(VkPhysicalDevice device) {
+                constexpr VkFormatFeatureFlags features =
+                    VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+
+                using enum assets::texture::eformat;
+
+                std::vector<assets::texture::eformat> out;
+                for (auto format : {bc1, bc3, bc7}) {
+                    VkFormatProperties properties;
+                    vkGetPhysicalDeviceFormatProperties(device, texture_format(format), &properties);
+
+                    if ((properties.optimalTilingFeatures & features) == features)
+                        out.push_back(format);
+                }
+
+                return out;
+            }
+        } // namespace
+
         std::expected<void, std::string> renderer::load_assets() {
             m_logger->debug("loading assets onto GPU");
 
-            for (auto& id : m_engine.current_scene().drawable_objects()) {
-                auto& asset_library_entry = m_engine.current_scene().asset_library()[id];
+            const auto compressed_formats = compressed_texture_formats(vk.physical_device.handle);
 
-                if (m_textures.contains(id))
+            // materials are shared and immutable, decode into a copy that's dropped once it's on the GPU
+            struct pending_texture {
+                assets::material_handle material;
+                assets::texture::etype type;
+                assets::texture texture;
+                std::expected<void, std::string> result;
+            };
+
+            std::vector<pending_texture> pending;
+            for (const auto& batch : m_draw_batches) {
+                if (m_textures.contains(batch.material) ||
+                    std::ranges::find(pending, batch.material, &pending_texture::material) != pending.end())
                     continue;
 
-                for (auto& [type, texture] : asset_library_entry.material.textures()) {
-                    if (auto res = texture.load(); !res)
-                        return res;
+                const auto& material = m_engine.current_scene().asset_library().material(batch.material);
+
+                for (const auto& [type, texture] : material.textures())
+                    pending.push_back({batch.material, type, texture});
+            }
+
+            // every texture is decoded on the job system while this thread records the uploads of the finished ones,
+            // the upload queue isn't thread safe. the jobs point into `pending`, it can't change size from here on
+            std::vector<job_system::handle> decodes;
+            decodes.reserve(pending.size());
+
+            for (auto& texture : pending)
+                decodes.push_back(m_engine.jobs().submit(
+                    [&texture, &compressed_formats] { texture.result = texture.texture.load(compressed_formats); }));
 
-                    m_logger->debug("loading a {}x{} texture ({} bytes)", texture.width(), texture.height(),
-                                    texture.pixels().size() * sizeof(*texture.pixels().begin()));
+            auto upload = [&](pending_texture& texture) -> std::expected<void, std::string> {
+                if (!texture.result)
+                    return texture.result;
 
-                    m_textures[id][type] = {vk.device, vk.physical_device.handle};
+                m_logger->debug("loading a {}x{} texture ({} bytes, {} levels)", texture.texture.width(),
+                                texture.texture.height(), texture.texture.data().size(), texture.texture.levels().size());
+
+                m_textures[texture.material][texture.type] = {vk.allocator};
+
+                auto res = m_textures[texture.material][texture.type].load(texture.texture, *this);
+                texture.texture = {};
+
+                return res;
+            };
 
-                    if (auto res = m_textures[id][type].load(texture, *this); !res)
-                        return res;
+            // uploads whichever decodes are done, when none are it helps with the oldest one until it is
+            std::vector<uint64_t> remaining(pending.size());
+            std::iota(remaining.begin(), remaining.end(), 0ull);
+
+            while (!remaining.empty()) {
+                auto ready = std::ranges::find_if(remaining, [&](uint64_t index) { return decodes[index].done(); });
+                if (ready == remaining.end()) {
+                    m_engine.jobs().wait(decodes[remaining.front()]);
+                    ready = remaining.begin();
+                }
+
+                auto res = upload(pending[*ready]);
+                remaining.erase(ready);
+
+                if (!res) {
+                    m_engine.jobs().wait(decodes);
+                    return res;
                 }
             }
 
@@ -52,10 +131,8 @@ namespace arbor {
                 m_image = VK_NULL_HANDLE;
             }
 
-            if (m_image_memory) {
-                vkFreeMemory(m_device, m_image_memory, nullptr);
-                m_image_memory = nullptr;
-            }
+            if (m_allocator)
+                m_allocator->free(m_image_memory);
         }
 
         std::expected<void, std::string> renderer::texture::load(const assets::texture& source, engine::renderer& renderer) {
@@ -64,9 +141,28 @@ namespace arbor {
             m_width = source.width();
             m_height = source.height();
 
-            if (auto res = renderer.make_image(m_width, m_height, VK_FORMAT_R8G8B8A8_UNORM,
-                                               VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
-                                               VK_IMAGE_ASPECT_COLOR_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+            const auto format = texture_format(source.format());
+
+            // compressed textures bring their levels along. decoded ones get the full chain down to 1x1 blitted from the
+            // base level, as long as the format can be blitted and filtered
+            VkFormatProperties format_properties;
+            vkGetPhysicalDeviceFormatProperties(renderer.vk.physical_device.handle, format, &format_properties);
+
+            constexpr VkFormatFeatureFlags blit_features = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT |
+                                                           VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+
+            if (source.levels().size() > 1 || source.format() != assets::texture::eformat::rgba8)
+                m_mip_levels = source.levels().size();
+            else if ((format_properties.optimalTilingFeatures & blit_features) == blit_features)
+                m_mip_levels = std::bit_width(std::max(m_width, m_height));
+            else
+                m_mip_levels = 1;
+
+            if (auto res = renderer.make_image(
+                    m_width, m_height, format,
+                    VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+                    VK_IMAGE_ASPECT_COLOR_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VK_SAMPLE_COUNT_1_BIT,
+                    renderer.m_uploads.queue_families(), m_mip_levels);
                 !res) {
                 return std::unexpected(res.error());
             } else {
@@ -78,43 +174,24 @@ namespace arbor {
 
             VkSamplerCreateInfo sampler_create_info{};
 
-            VkMemoryRequirements memory_requirements;
-            vkGetImageMemoryRequirements(m_device, m_image, &memory_requirements);
+            std::vector<VkBufferImageCopy> regions;
+            for (auto level = 0u; level < source.levels().size(); level++) {
+                const auto& mip = source.levels()[level];
 
-            VkPhysicalDeviceMemoryProperties memory_properties;
-            vkGetPhysicalDeviceMemoryProperties(m_physical_device, &memory_properties);
-
-            m_staging_buffer.make(memory_requirements.size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                                  VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, m_device,
-                                  m_physical_device);
-
-            m_staging_buffer.write_data(source.pixels().data(), memory_requirements.size);
-
-            renderer.transition_image_layout(m_image, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_UNDEFINED,
-                                             VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-
-            auto command_buffer = renderer.begin_temporary_command_buffer();
-            if (!command_buffer)
-                return std::unexpected(command_buffer.error());
-
-            VkBufferImageCopy image_copy_region{};
-            image_copy_region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-            image_copy_region.imageSubresource.layerCount = 1;
-            image_copy_region.imageExtent.width = m_width;
-            image_copy_region.imageExtent.height = m_height;
-            image_copy_region.imageExtent.depth = 1;
-
-            vkCmdCopyBufferToImage(*command_buffer, *m_staging_buffer.buffer(), m_image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1,
-                                   &image_copy_region);
-
-            vkEndCommandBuffer(*command_buffer);
+                auto& region = regions.emplace_back();
+                region.bufferOffset = mip.offset;
+                region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+                region.imageSubresource.mipLevel = level;
+                region.imageSubresource.layerCount = 1;
+                region.imageExtent = {static_cast<uint32_t>(mip.width), static_cast<uint32_t>(mip.height), 1};
+            }
 
-            if (auto res = renderer.submit_command_buffer(*command_buffer, renderer.vk.graphics_queue); !res)
+            // recorded into the pending upload batch, the first frame drawn after it's submitted waits for it
+            if (auto res = renderer.m_uploads.copy_to_image(source.data().data(), source.data().size(), m_image, regions,
+                                                            m_mip_levels);
+                !res)
                 return res;
 
-            renderer.transition_image_layout(m_image, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                                             VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-
             sampler_create_info.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
             sampler_create_info.magFilter = VK_FILTER_LINEAR;
             sampler_create_info.minFilter = VK_FILTER_LINEAR;
@@ -125,6 +202,8 @@ namespace arbor {
             sampler_create_info.maxAnisotropy = renderer.vk.physical_device.properties.limits.maxSamplerAnisotropy;
             sampler_create_info.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
             sampler_create_info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+            sampler_create_info.minLod = 0.0f;
+            sampler_create_info.maxLod = static_cast<float32_t>(m_mip_levels);
             sampler_create_info.compareOp = VK_COMPARE_OP_ALWAYS;
 
             if (auto res = vkCreateSampler(m_device, &sampler_create_info, nullptr, &m_sampler); res != VK_SUCCESS)
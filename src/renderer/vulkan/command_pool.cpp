@@ -30,6 +30,37 @@ namespace arbor {
             if (auto res = vkAllocateCommandBuffers(vk.device, &buffer_alloc_info, vk.command_buffers.data()); res != VK_SUCCESS)
                 return std::unexpected(fmt::format("failed to allocate a vulkan command buffer: {}", string_VkResult(res)));
 
+            // command pools are externally synchronized, so every chunk recorded in parallel needs its own per frame in flight
+            vk.recording.n_threads = m_engine.jobs().concurrency();
+            vk.recording.pools.resize(vk.recording.n_threads * vk.sync.frames_in_flight);
+            vk.recording.draw_buffers.resize(vk.recording.pools.size());
+            vk.recording.gui_buffers.resize(vk.sync.frames_in_flight);
+
+            m_logger->trace("creating {} secondary command pools for {} recording threads", vk.recording.pools.size(),
+                            vk.recording.n_threads);
+
+            pool_create_info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+            buffer_alloc_info.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+            buffer_alloc_info.commandBufferCount = 1;
+
+            for (auto i = 0ull; i < vk.recording.pools.size(); i++) {
+                if (auto res = vkCreateCommandPool(vk.device, &pool_create_info, nullptr, &vk.recording.pools[i]);
+                    res != VK_SUCCESS)
+                    return std::unexpected(fmt::format("failed to create a vulkan command pool: {}", string_VkResult(res)));
+
+                buffer_alloc_info.commandPool = vk.recording.pools[i];
+                if (auto res = vkAllocateCommandBuffers(vk.device, &buffer_alloc_info, &vk.recording.draw_buffers[i]);
+                    res != VK_SUCCESS)
+                    return std::unexpected(fmt::format("failed to allocate a vulkan command buffer: {}", string_VkResult(res)));
+            }
+
+            for (auto frame = 0u; frame < vk.sync.frames_in_flight; frame++) {
+                buffer_alloc_info.commandPool = vk.recording.pools[frame * vk.recording.n_threads];
+                if (auto res = vkAllocateCommandBuffers(vk.device, &buffer_alloc_info, &vk.recording.gui_buffers[frame]);
+                    res != VK_SUCCESS)
+                    return std::unexpected(fmt::format("failed to allocate a vulkan command buffer: {}", string_VkResult(res)));
+            }
+
             return {};
         }
 
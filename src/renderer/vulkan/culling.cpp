@@ -0,0 +1,846 @@
+#include "arbor/components/renderer.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+
+#include "vulkan/vk_enum_string_helper.h"
+
+namespace arbor {
+    namespace engine {
+        namespace {
+            // matches the std140 block in the cull shader
+            struct cull_parameters {
+                glm::mat4 view_projection;
+                glm::mat4 previous_view_projection;
+                std::array<glm::vec4, 6> frustum;
+                glm::vec2 pyramid_size;
+                uint32_t pyramid_levels;
+                uint32_t n_instances;
+                uint32_t n_batches;
+                uint32_t occlusion;
+                uint32_t compact;
+                uint32_t padding;
+            };
+
+            struct reduce_parameters {
+                glm::ivec2 source_size;
+                uint32_t samples;
+            };
+
+            constexpr uint32_t cull_group_size = 64;
+            constexpr uint32_t reduce_group_size = 8;
+
+            // phase 0 runs per instance, phase 1 per batch once every instance count is final
+            constexpr auto cull_glsl = R"(
+#version 460
+layout(local_size_x = 64) in;
+
+struct draw_command {
+    uint index_count;
+    uint instance_count;
+    uint first_index;
+    int vertex_offset;
+    uint first_instance;
+};
+
+struct batch_data {
+    vec4 bounds;
+    uint first_instance;
+    uint material_set;
+    uint first_draw;
+    uint padding;
+};
+
+layout(set = 0, binding = 0) uniform cull_parameters {
+    mat4 view_projection;
+    mat4 previous_view_projection;
+    vec4 frustum[6];
+    vec2 pyramid_size;
+    uint pyramid_levels;
+    uint n_instances;
+    uint n_batches;
+    uint occlusion;
+    uint compact;
+} params;
+
+layout(set = 0, binding = 1) readonly buffer batch_buffer { batch_data batches[]; };
+layout(set = 0, binding = 2) readonly buffer instance_batch_buffer { uint instance_batches[]; };
+layout(set = 0, binding = 3) readonly buffer transform_buffer { mat4 models[]; };
+layout(set = 0, binding = 4) writeonly buffer visible_buffer { uint visible[]; };
+layout(set = 0, binding = 5) buffer draw_buffer { draw_command draws[]; };
+layout(set = 0, binding = 6) writeonly buffer compacted_buffer { draw_command compacted[]; };
+layout(set = 0, binding = 7) buffer count_buffer { uint counts[]; };
+layout(set = 0, binding = 8) uniform sampler2D depth_pyramid;
+
+layout(push_constant) uniform cull_phase {
+    uint phase;
+};
+
+bool occluded(vec3 center, float radius) {
+    vec2 uv_min = vec2(1.0);
+    vec2 uv_max = vec2(0.0);
+    float nearest = 1.0;
+
+    for (int i = 0; i < 8; i++) {
+        vec3 corner = center + radius * vec3((i & 1) != 0 ? 1.0 : -1.0, (i & 2) != 0 ? 1.0 : -1.0, (i & 4) != 0 ? 1.0 : -1.0);
+        vec4 clip = params.previous_view_projection * vec4(corner, 1.0);
+
+        // the bounds cross the near plane, there's nothing sensible to compare against
+        if (clip.w <= 0.0)
+            return false;
+
+        vec3 ndc = clip.xyz / clip.w;
+        uv_min = min(uv_min, ndc.xy * 0.5 + 0.5);
+        uv_max = max(uv_max, ndc.xy * 0.5 + 0.5);
+        nearest = min(nearest, ndc.z);
+    }
+
+    uv_min = clamp(uv_min, 0.0, 1.0);
+    uv_max = clamp(uv_max, 0.0, 1.0);
+
+    // pick the level where the footprint covers at most 2x2 texels
+    vec2 extent = (uv_max - uv_min) * params.pyramid_size;
+    int level = clamp(int(ceil(log2(max(max(extent.x, extent.y), 1.0)))), 0, int(params.pyramid_levels) - 1);
+
+    ivec2 level_size = textureSize(depth_pyramid, level);
+    ivec2 texel_min = clamp(ivec2(uv_min * vec2(level_size)), ivec2(0), level_size - 1);
+    ivec2 texel_max = clamp(ivec2(uv_max * vec2(level_size)), ivec2(0), level_size - 1);
+
+    float farthest = max(max(texelFetch(depth_pyramid, texel_min, level).r,
+                             texelFetch(depth_pyramid, ivec2(texel_max.x, texel_min.y), level).r),
+                         max(texelFetch(depth_pyramid, ivec2(texel_min.x, texel_max.y), level).r,
+                             texelFetch(depth_pyramid, texel_max, level).r));
+
+    return nearest > farthest;
+}
+
+void main() {
+    uint i = gl_GlobalInvocationID.x;
+
+    if (phase == 0) {
+        if (i >= params.n_instances)
+            return;
+
+        uint batch_index = instance_batches[i];
+        batch_data batch = batches[batch_index];
+        mat4 model = models[i];
+
+        vec3 center = (model * vec4(batch.bounds.xyz, 1.0)).xyz;
+        float radius = batch.bounds.w * max(max(length(model[0].xyz), length(model[1].xyz)), length(model[2].xyz));
+
+        for (int plane = 0; plane < 6; plane++)
+            if (dot(params.frustum[plane], vec4(center, 1.0)) < -radius)
+                return;
+
+        if (params.occlusion != 0 && occluded(center, radius))
+            return;
+
+        uint slot = atomicAdd(draws[batch_index].instance_count, 1);
+        visible[batch.first_instance + slot] = i;
+    } else {
+        if (i >= params.n_batches || params.compact == 0 || draws[i].instance_count == 0)
+            return;
+
+        batch_data batch = batches[i];
+
+        uint slot = atomicAdd(counts[batch.material_set], 1);
+        compacted[batch.first_draw + slot] = draws[i];
+    }
+}
+)";
+
+            // level 0 of the pyramid keeps the farthest depth of every pixel's samples
+            constexpr auto depth_reduce_glsl = R"(
+#version 460
+layout(local_size_x = 8, local_size_y = 8) in;
+
+layout(set = 0, binding = 0) uniform sampler2DMS source;
+layout(set = 0, binding = 1, r32f) uniform writeonly image2D level;
+
+layout(push_constant) uniform reduce_parameters {
+    ivec2 source_size;
+    uint samples;
+};
+
+void main() {
+    ivec2 texel = ivec2(gl_GlobalInvocationID.xy);
+    if (any(greaterThanEqual(texel, imageSize(level))))
+        return;
+
+    float farthest = 0.0;
+    for (int i = 0; i < int(samples); i++)
+        farthest = max(farthest, texelFetch(source, texel, i).r);
+
+    imageStore(level, texel, vec4(farthest));
+}
+)";
+
+            constexpr auto pyramid_reduce_glsl = R"(
+#version 460
+layout(local_size_x = 8, local_size_y = 8) in;
+
+layout(set = 0, binding = 0) uniform sampler2D source;
+layout(set = 0, binding = 1, r32f) uniform writeonly image2D level;
+
+layout(push_constant) uniform reduce_parameters {
+    ivec2 source_size;
+    uint samples;
+};
+
+void main() {
+    ivec2 texel = ivec2(gl_GlobalInvocationID.xy);
+    ivec2 size = imageSize(level);
+    if (any(greaterThanEqual(texel, size)))
+        return;
+
+    // odd source dimensions fold their last row or column into the edge texels, so no depth is ever skipped
+    ivec2 first = texel * 2;
+    ivec2 last = min(first + 1 + ivec2(equal(texel, size - 1)) * (source_size & 1), source_size - 1);
+
+    float farthest = 0.0;
+    for (int y = first.y; y <= last.y; y++)
+        for (int x = first.x; x <= last.x; x++)
+            farthest = max(farthest, texelFetch(source, ivec2(x, y), 0).r);
+
+    imageStore(level, texel, vec4(farthest));
+}
+)";
+        } // namespace
+
+        std::array<glm::vec4, 6> detail::frustum_planes(const glm::mat4& view_projection) {
+            const auto row = [&](int32_t i) {
+                return glm::vec4(view_projection[0][i], view_projection[1][i], view_projection[2][i], view_projection[3][i]);
+            };
+
+            // vulkan's clip volume is -w <= x, y <= w and 0 <= z <= w
+            std::array<glm::vec4, 6> planes = {
+                row(3) + row(0), row(3) - row(0), row(3) + row(1), row(3) - row(1), row(2), row(3) - row(2),
+            };
+
+            for (auto& plane : planes)
+                plane /= glm::length(glm::vec3(plane));
+
+            return planes;
+        }
+
+        renderer::cull_pass::~cull_pass() {
+            destroy();
+        }
+
+        void renderer::cull_pass::destroy() {
+            auto device = m_renderer.vk.device;
+            if (!device)
+                return;
+
+            destroy_pyramid();
+
+            m_batches.free();
+            m_instance_batches.free();
+            m_parameters.free();
+
+            if (m_pyramid_sampler) {
+                vkDestroySampler(device, m_pyramid_sampler, nullptr);
+                m_pyramid_sampler = VK_NULL_HANDLE;
+            }
+
+            for (auto pipeline : {&m_cull_pipeline, &m_depth_reduce_pipeline, &m_pyramid_reduce_pipeline}) {
+                if (*pipeline)
+                    vkDestroyPipeline(device, *pipeline, nullptr);
+                *pipeline = VK_NULL_HANDLE;
+            }
+
+            for (auto layout : {&m_cull_layout, &m_reduce_layout}) {
+                if (*layout)
+                    vkDestroyPipelineLayout(device, *layout, nullptr);
+                *layout = VK_NULL_HANDLE;
+            }
+
+            for (auto pool : {&m_cull_descriptor_pool, &m_reduce_descriptor_pool}) {
+                if (*pool)
+                    vkDestroyDescriptorPool(device, *pool, nullptr);
+                *pool = VK_NULL_HANDLE;
+            }
+
+            for (auto layout : {&m_cull_set_layout, &m_reduce_set_layout}) {
+                if (*layout)
+                    vkDestroyDescriptorSetLayout(device, *layout, nullptr);
+                *layout = VK_NULL_HANDLE;
+            }
+
+            m_cull_descriptor_sets.clear();
+            m_reduce_descriptor_sets.clear();
+        }
+
+        void renderer::cull_pass::destroy_pyramid() {
+            auto device = m_renderer.vk.device;
+
+            if (m_reduce_descriptor_pool) {
+                vkDestroyDescriptorPool(device, m_reduce_descriptor_pool, nullptr);
+                m_reduce_descriptor_pool = VK_NULL_HANDLE;
+                m_reduce_descriptor_sets.clear();
+            }
+
+            for (auto view : m_pyramid_level_views)
+                vkDestroyImageView(device, view, nullptr);
+            m_pyramid_level_views.clear();
+
+            if (m_pyramid_view) {
+                vkDestroyImageView(device, m_pyramid_view, nullptr);
+                m_pyramid_view = VK_NULL_HANDLE;
+            }
+
+            if (m_pyramid) {
+                vkDestroyImage(device, m_pyramid, nullptr);
+                m_pyramid = VK_NULL_HANDLE;
+            }
+
+            m_renderer.vk.allocator.free(m_pyramid_memory);
+
+            m_depth_valid = false;
+        }
+
+        std::expected<void, std::string> renderer::cull_pass::make_pipelines() {
+            auto& vk = m_renderer.vk;
+            if (!vk.config.gpu_culling)
+                return {};
+
+            m_renderer.m_logger->trace("creating the culling pipelines");
+
+            std::array<VkDescriptorSetLayoutBinding, 9> cull_bindings{};
+            for (auto i = 0u; i < cull_bindings.size(); i++) {
+                cull_bindings[i].binding = i;
+                cull_bindings[i].descriptorCount = 1;
+                cull_bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+                cull_bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+            }
+
+            cull_bindings.front().descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+            cull_bindings.back().descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+
+            std::array<VkDescriptorSetLayoutBinding, 2> reduce_bindings{};
+            for (auto i = 0u; i < reduce_bindings.size(); i++) {
+                reduce_bindings[i].binding = i;
+                reduce_bindings[i].descriptorCount = 1;
+                reduce_bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+            }
+
+            reduce_bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+            reduce_bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+
+            VkDescriptorSetLayoutCreateInfo set_layout_create_info{};
+            set_layout_create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+
+            set_layout_create_info.bindingCount = cull_bindings.size();
+            set_layout_create_info.pBindings = cull_bindings.data();
+            if (auto res = vkCreateDescriptorSetLayout(vk.device, &set_layout_create_info, nullptr, &m_cull_set_layout);
+                res != VK_SUCCESS)
+                return std::unexpected(fmt::format("failed to create a descriptor set layout: {}", string_VkResult(res)));
+
+            set_layout_create_info.bindingCount = reduce_bindings.size();
+            set_layout_create_info.pBindings = reduce_bindings.data();
+            if (auto res = vkCreateDescriptorSetLayout(vk.device, &set_layout_create_info, nullptr, &m_reduce_set_layout);
+                res != VK_SUCCESS)
+                return std::unexpected(fmt::format("failed to create a descriptor set layout: {}", string_VkResult(res)));
+
+            VkPushConstantRange push_constants{};
+            VkPipelineLayoutCreateInfo layout_create_info{};
+
+            push_constants.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+            push_constants.size = sizeof(uint32_t);
+
+            layout_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+            layout_create_info.setLayoutCount = 1;
+            layout_create_info.pSetLayouts = &m_cull_set_layout;
+            layout_create_info.pushConstantRangeCount = 1;
+            layout_create_info.pPushConstantRanges = &push_constants;
+
+            if (auto res = vkCreatePipelineLayout(vk.device, &layout_create_info, nullptr, &m_cull_layout); res != VK_SUCCESS)
+                return std::unexpected(fmt::format("failed to create a pipeline layout: {}", string_VkResult(res)));
+
+            push_constants.size = sizeof(reduce_parameters);
+            layout_create_info.pSetLayouts = &m_reduce_set_layout;
+
+            if (auto res = vkCreatePipelineLayout(vk.device, &layout_create_info, nullptr, &m_reduce_layout); res != VK_SUCCESS)
+                return std::unexpected(fmt::format("failed to create a pipeline layout: {}", string_VkResult(res)));
+
+            const auto make_pipeline = [&](const char* name, const char* glsl, VkPipelineLayout layout,
+                                           VkPipeline& pipeline) -> std::expected<void, std::string> {
+                auto shader = renderer::shader::from_glsl(name, glsl, shader::compute, vk.device);
+                if (auto res = shader.compile(vk.shader_cache_path); !res)
+                    return res;
+
+                VkComputePipelineCreateInfo create_info{};
+
+                create_info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+                create_info.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+                create_info.stage.stage = shader.stage();
+                create_info.stage.module = shader.shader_module();
+                create_info.stage.pName = "main";
+                create_info.layout = layout;
+
+                if (auto res = vkCreateComputePipelines(vk.device, vk.pipeline_cache, 1, &create_info, nullptr, &pipeline);
+                    res != VK_SUCCESS)
+                    return std::unexpected(fmt::format("failed to create a compute pipeline: {}", string_VkResult(res)));
+
+                return {};
+            };
+
+            if (auto res = make_pipeline("cull.comp", cull_glsl, m_cull_layout, m_cull_pipeline); !res)
+                return res;
+
+            if (auto res = make_pipeline("depth_reduce.comp", depth_reduce_glsl, m_reduce_layout, m_depth_reduce_pipeline); !res)
+                return res;
+
+            if (auto res = make_pipeline("pyramid_reduce.comp", pyramid_reduce_glsl, m_reduce_layout, m_pyramid_reduce_pipeline);
+                !res)
+                return res;
+
+            VkSamplerCreateInfo sampler_create_info{};
+
+            // the pyramid is only ever read with texelFetch, the sampler just has to cover every level
+            sampler_create_info.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+            sampler_create_info.magFilter = VK_FILTER_NEAREST;
+            sampler_create_info.minFilter = VK_FILTER_NEAREST;
+            sampler_create_info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+            sampler_create_info.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+            sampler_create_info.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+            sampler_create_info.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+            sampler_create_info.maxLod = VK_LOD_CLAMP_NONE;
+
+            if (auto res = vkCreateSampler(vk.device, &sampler_create_info, nullptr, &m_pyramid_sampler); res != VK_SUCCESS)
+                return std::unexpected(fmt::format("failed to create a sampler: {}", string_VkResult(res)));
+
+            const auto alignment = vk.physical_device.properties.limits.minUniformBufferOffsetAlignment;
+            m_parameters_frame_size = (sizeof(cull_parameters) + alignment - 1) / alignment * alignment;
+
+            if (auto res = m_parameters.make(m_parameters_frame_size * vk.sync.frames_in_flight,
+                                             VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+                                             VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                             vk.allocator);
+                !res)
+                return res;
+
+            return {};
+        }
+
+        std::expected<void, std::string> renderer::cull_pass::make_pyramid() {
+            auto& vk = m_renderer.vk;
+            if (!vk.config.gpu_culling)
+                return {};
+
+            destroy_pyramid();
+
+            m_pyramid_width = vk.swapchain.extent.width;
+            m_pyramid_height = vk.swapchain.extent.height;
+            m_pyramid_levels = std::bit_width(std::max(m_pyramid_width, m_pyramid_height));
+
+            m_renderer.m_logger->trace("creating a {}x{} depth pyramid with {} levels", m_pyramid_width, m_pyramid_height,
+                                       m_pyramid_levels);
+
+            VkImageCreateInfo create_info{};
+
+            create_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+            create_info.imageType = VK_IMAGE_TYPE_2D;
+            create_info.extent.width = m_pyramid_width;
+            create_info.extent.height = m_pyramid_height;
+            create_info.extent.depth = 1;
+            create_info.mipLevels = m_pyramid_levels;
+            create_info.arrayLayers = 1;
+            create_info.format = VK_FORMAT_R32_SFLOAT;
+            create_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+            create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+            create_info.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+            create_info.samples = VK_SAMPLE_COUNT_1_BIT;
+
+            if (auto res = vkCreateImage(vk.device, &create_info, nullptr, &m_pyramid); res != VK_SUCCESS)
+                return std::unexpected(fmt::format("failed to create the depth pyramid: {}", string_VkResult(res)));
+
+            if (auto res = vk.allocator.allocate(m_pyramid, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT); res)
+                m_pyramid_memory = *res;
+            else
+                return std::unexpected(fmt::format("failed to allocate device memory for the depth pyramid: {}", res.error()));
+
+            VkImageViewCreateInfo view_create_info{};
+
+            view_create_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+            view_create_info.image = m_pyramid;
+            view_create_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+            view_create_info.format = VK_FORMAT_R32_SFLOAT;
+            view_create_info.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            view_create_info.subresourceRange.layerCount = 1;
+            view_create_info.subresourceRange.levelCount = m_pyramid_levels;
+
+            if (auto res = vkCreateImageView(vk.device, &view_create_info, nullptr, &m_pyramid_view); res != VK_SUCCESS)
+                return std::unexpected(fmt::format("failed to create a depth pyramid view: {}", string_VkResult(res)));
+
+            m_pyramid_level_views.resize(m_pyramid_levels);
+            view_create_info.subresourceRange.levelCount = 1;
+
+            for (auto i = 0u; i < m_pyramid_levels; i++) {
+                view_create_info.subresourceRange.baseMipLevel = i;
+
+                if (auto res = vkCreateImageView(vk.device, &view_create_info, nullptr, &m_pyramid_level_views[i]);
+                    res != VK_SUCCESS)
+                    return std::unexpected(fmt::format("failed to create a depth pyramid view: {}", string_VkResult(res)));
+            }
+
+            // the pyramid stays in the general layout for its whole life, the cull shader samples it even before the
+            // first reduce writes it (or when nothing ever does)
+            if (auto res = m_renderer.transition_image_layout(m_pyramid, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_UNDEFINED,
+                                                              VK_IMAGE_LAYOUT_GENERAL);
+                !res)
+                return res;
+
+            // without occlusion culling the pyramid is never built, the cull shader still needs something bound to read
+            if (!vk.config.occlusion_culling) {
+                write_pyramid_descriptors();
+                return {};
+            }
+
+            VkDescriptorPoolSize pool_sizes[2] = {
+                {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, m_pyramid_levels},
+                {VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, m_pyramid_levels},
+            };
+
+            VkDescriptorPoolCreateInfo pool_create_info{};
+
+            pool_create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+            pool_create_info.poolSizeCount = 2;
+            pool_create_info.pPoolSizes = pool_sizes;
+            pool_create_info.maxSets = m_pyramid_levels;
+
+            if (auto res = vkCreateDescriptorPool(vk.device, &pool_create_info, nullptr, &m_reduce_descriptor_pool);
+                res != VK_SUCCESS)
+                return std::unexpected(fmt::format("failed to create a descriptor pool: {}", string_VkResult(res)));
+
+            std::vector<VkDescriptorSetLayout> layouts(m_pyramid_levels, m_reduce_set_layout);
+            VkDescriptorSetAllocateInfo allocation_info{};
+
+            allocation_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+            allocation_info.descriptorPool = m_reduce_descriptor_pool;
+            allocation_info.descriptorSetCount = layouts.size();
+            allocation_info.pSetLayouts = layouts.data();
+
+            m_reduce_descriptor_sets.resize(m_pyramid_levels);
+            if (auto res = vkAllocateDescriptorSets(vk.device, &allocation_info, m_reduce_descriptor_sets.data());
+                res != VK_SUCCESS)
+                return std::unexpected(fmt::format("failed to allocate descriptor sets: {}", string_VkResult(res)));
+
+            write_pyramid_descriptors();
+
+            return {};
+        }
+
+        void renderer::cull_pass::write_pyramid_descriptors() {
+            auto& vk = m_renderer.vk;
+
+            std::vector<VkWriteDescriptorSet> writes;
+            std::vector<VkDescriptorImageInfo> image_infos;
+            image_infos.reserve(m_reduce_descriptor_sets.size() * 2 + m_cull_descriptor_sets.size());
+
+            const auto write = [&](VkDescriptorSet set, uint32_t binding, VkDescriptorType type, VkImageView view) {
+                image_infos.push_back({m_pyramid_sampler, view, VK_IMAGE_LAYOUT_GENERAL});
+
+                VkWriteDescriptorSet descriptor_write{};
+                descriptor_write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+                descriptor_write.dstSet = set;
+                descriptor_write.dstBinding = binding;
+                descriptor_write.descriptorType = type;
+                descriptor_write.descriptorCount = 1;
+                descriptor_write.pImageInfo = &image_infos.back();
+
+                writes.push_back(descriptor_write);
+            };
+
+            for (auto i = 0ull; i < m_reduce_descriptor_sets.size(); i++) {
+                // level 0 reads the multisampled depth buffer, every other level the one above it
+                if (i == 0) {
+                    write(m_reduce_descriptor_sets[i], 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                          vk.swapchain.depth_image_view);
+                    image_infos.back().imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+                } else {
+                    write(m_reduce_descriptor_sets[i], 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                          m_pyramid_level_views[i - 1]);
+                }
+
+                write(m_reduce_descriptor_sets[i], 1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, m_pyramid_level_views[i]);
+            }
+
+            for (auto set : m_cull_descriptor_sets)
+                write(set, 8, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, m_pyramid_view);
+
+            vkUpdateDescriptorSets(vk.device, writes.size(), writes.data(), 0, nullptr);
+        }
+
+        std::expected<void, std::string> renderer::cull_pass::make_descriptor_sets() {
+            auto& vk = m_renderer.vk;
+            if (!vk.config.gpu_culling)
+                return {};
+
+            // the batches of the frames in flight are left alone, they get new buffers and sets
+            if (*m_batches.buffer())
+                m_renderer.retire(m_batches.release());
+
+            if (*m_instance_batches.buffer())
+                m_renderer.retire(m_instance_batches.release());
+
+            if (m_cull_descriptor_pool) {
+                m_renderer.retire([device = vk.device, pool = m_cull_descriptor_pool] {
+                    vkDestroyDescriptorPool(device, pool, nullptr);
+                });
+
+                m_cull_descriptor_pool = VK_NULL_HANDLE;
+                m_cull_descriptor_sets.clear();
+            }
+
+            const auto& draw_batches = m_renderer.m_draw_batches;
+
+            std::vector<detail::cull_batch> batches;
+            std::vector<uint32_t> instance_batches(m_renderer.m_instances.size());
+            batches.reserve(draw_batches.size());
+
+            for (auto i = 0ull; i < draw_batches.size(); i++) {
+                const auto& batch = draw_batches[i];
+
+                // the compacted commands of a material start where its run of batches does
+                auto first_draw = i;
+                while (first_draw > 0 && draw_batches[first_draw - 1].material_set == batch.material_set)
+                    first_draw--;
+
+                batches.push_back({
+                    .bounds = batch.bounds,
+                    .first_instance = batch.first_instance,
+                    .material_set = batch.material_set,
+                    .first_draw = static_cast<uint32_t>(first_draw),
+                    .padding = 0,
+                });
+
+                std::fill_n(instance_batches.begin() + batch.first_instance, batch.instance_count, i);
+            }
+
+            // zero sized buffers aren't valid, an empty scene still gets a single element
+            batches.resize(std::max<uint64_t>(batches.size(), 1));
+            instance_batches.resize(std::max<uint64_t>(instance_batches.size(), 1));
+
+            if (auto res = m_batches.make(batches.size() * sizeof(detail::cull_batch), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                          VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                          vk.allocator);
+                !res)
+                return res;
+
+            if (auto res = m_batches.write_data(batches.data(), m_batches.size()); !res)
+                return res;
+
+            if (auto res = m_instance_batches.make(instance_batches.size() * sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                                   VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                                   vk.allocator);
+                !res)
+                return res;
+
+            if (auto res = m_instance_batches.write_data(instance_batches.data(), m_instance_batches.size()); !res)
+                return res;
+
+            const auto n_sets = vk.sync.frames_in_flight;
+
+            VkDescriptorPoolSize pool_sizes[3] = {
+                {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, n_sets},
+                {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 7 * n_sets},
+                {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, n_sets},
+            };
+
+            VkDescriptorPoolCreateInfo pool_create_info{};
+
+            pool_create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+            pool_create_info.poolSizeCount = 3;
+            pool_create_info.pPoolSizes = pool_sizes;
+            pool_create_info.maxSets = n_sets;
+
+            if (auto res = vkCreateDescriptorPool(vk.device, &pool_create_info, nullptr, &m_cull_descriptor_pool);
+                res != VK_SUCCESS)
+                return std::unexpected(fmt::format("failed to create a descriptor pool: {}", string_VkResult(res)));
+
+            std::vector<VkDescriptorSetLayout> layouts(n_sets, m_cull_set_layout);
+            VkDescriptorSetAllocateInfo allocation_info{};
+
+            allocation_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+            allocation_info.descriptorPool = m_cull_descriptor_pool;
+            allocation_info.descriptorSetCount = layouts.size();
+            allocation_info.pSetLayouts = layouts.data();
+
+            m_cull_descriptor_sets.resize(n_sets);
+            if (auto res = vkAllocateDescriptorSets(vk.device, &allocation_info, m_cull_descriptor_sets.data());
+                res != VK_SUCCESS)
+                return std::unexpected(fmt::format("failed to allocate descriptor sets: {}", string_VkResult(res)));
+
+            const auto frame_ring_visible_offset = vk.frame_ring_camera_size + vk.frame_ring_transforms_size;
+
+            for (auto frame = 0u; frame < n_sets; frame++) {
+                const auto ring = frame * vk.frame_ring_frame_size;
+                const auto indirect = frame * vk.indirect_frame_size;
+
+                std::array<VkDescriptorBufferInfo, 8> buffer_infos = {
+                    VkDescriptorBufferInfo{*m_parameters.buffer(), frame * m_parameters_frame_size, sizeof(cull_parameters)},
+                    VkDescriptorBufferInfo{*m_batches.buffer(), 0, VK_WHOLE_SIZE},
+                    VkDescriptorBufferInfo{*m_instance_batches.buffer(), 0, VK_WHOLE_SIZE},
+                    VkDescriptorBufferInfo{*vk.frame_ring.buffer(), ring + vk.frame_ring_camera_size,
+                                           vk.frame_ring_transforms_size},
+                    VkDescriptorBufferInfo{*vk.frame_ring.buffer(), ring + frame_ring_visible_offset,
+                                           vk.frame_ring_frame_size - frame_ring_visible_offset},
+                    VkDescriptorBufferInfo{*vk.indirect_buffer.buffer(), indirect, vk.indirect_compacted_offset},
+                    VkDescriptorBufferInfo{*vk.indirect_buffer.buffer(), indirect + vk.indirect_compacted_offset,
+                                           vk.indirect_counts_offset - vk.indirect_compacted_offset},
+                    VkDescriptorBufferInfo{*vk.indirect_buffer.buffer(), indirect + vk.indirect_counts_offset,
+                                           vk.indirect_frame_size - vk.indirect_counts_offset},
+                };
+
+                std::array<VkWriteDescriptorSet, 8> writes{};
+                for (auto i = 0u; i < writes.size(); i++) {
+                    writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+                    writes[i].dstSet = m_cull_descriptor_sets[frame];
+                    writes[i].dstBinding = i;
+                    writes[i].descriptorType = i == 0 ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+                    writes[i].descriptorCount = 1;
+                    writes[i].pBufferInfo = &buffer_infos[i];
+                }
+
+                vkUpdateDescriptorSets(vk.device, writes.size(), writes.data(), 0, nullptr);
+            }
+
+            if (m_pyramid_view)
+                write_pyramid_descriptors();
+
+            return {};
+        }
+
+        std::expected<void, std::string> renderer::cull_pass::record(VkCommandBuffer command_buffer) {
+            auto& vk = m_renderer.vk;
+            if (!vk.config.gpu_culling || m_cull_descriptor_sets.empty())
+                return {};
+
+            const auto frame = vk.sync.current_frame;
+            const auto occlusion = vk.config.occlusion_culling && m_depth_valid && !m_reduce_descriptor_sets.empty();
+
+            if (occlusion) {
+                std::array<VkImageMemoryBarrier, 2> barriers{};
+
+                for (auto& barrier : barriers) {
+                    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+                    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                    barrier.subresourceRange.layerCount = 1;
+                    barrier.subresourceRange.levelCount = 1;
+                }
+
+                barriers[0].image = vk.swapchain.depth_image;
+                barriers[0].oldLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+                barriers[0].newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+                barriers[0].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+                barriers[0].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+                barriers[0].subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+
+                // the previous frame's cull dispatch may still be reading the pyramid
+                barriers[1].image = m_pyramid;
+                barriers[1].oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+                barriers[1].newLayout = VK_IMAGE_LAYOUT_GENERAL;
+                barriers[1].srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+                barriers[1].dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+                barriers[1].subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+                barriers[1].subresourceRange.levelCount = m_pyramid_levels;
+
+                vkCmdPipelineBarrier(command_buffer,
+                                     VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                     VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, barriers.size(),
+                                     barriers.data());
+
+                VkImageMemoryBarrier level_barrier = barriers[1];
+                level_barrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+                level_barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+                level_barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+                level_barrier.subresourceRange.levelCount = 1;
+
+                for (auto level = 0u; level < m_pyramid_levels; level++) {
+                    const auto width = std::max(m_pyramid_width >> level, 1u);
+                    const auto height = std::max(m_pyramid_height >> level, 1u);
+
+                    reduce_parameters parameters = {
+                        .source_size = level == 0 ? glm::ivec2(m_pyramid_width, m_pyramid_height)
+                                                  : glm::ivec2(std::max(m_pyramid_width >> (level - 1), 1u),
+                                                               std::max(m_pyramid_height >> (level - 1), 1u)),
+                        .samples = static_cast<uint32_t>(vk.config.sample_count),
+                    };
+
+                    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                                      level == 0 ? m_depth_reduce_pipeline : m_pyramid_reduce_pipeline);
+                    vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_reduce_layout, 0, 1,
+                                            &m_reduce_descriptor_sets[level], 0, nullptr);
+                    vkCmdPushConstants(command_buffer, m_reduce_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(parameters),
+                                       &parameters);
+                    vkCmdDispatch(command_buffer, (width + reduce_group_size - 1) / reduce_group_size,
+                                  (height + reduce_group_size - 1) / reduce_group_size, 1);
+
+                    level_barrier.subresourceRange.baseMipLevel = level;
+                    vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &level_barrier);
+                }
+
+                // the render pass clears the depth buffer again, it just has to wait for the reads above
+                barriers[0].oldLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+                barriers[0].newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+                barriers[0].srcAccessMask = 0;
+                barriers[0].dstAccessMask =
+                    VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+                vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                     VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, 0,
+                                     0, nullptr, 0, nullptr, 1, &barriers[0]);
+            }
+
+            cull_parameters parameters = {
+                .view_projection = m_renderer.m_view_projection,
+                .previous_view_projection = m_previous_view_projection,
+                .frustum = detail::frustum_planes(m_renderer.m_view_projection),
+                .pyramid_size = glm::vec2(m_pyramid_width, m_pyramid_height),
+                .pyramid_levels = m_pyramid_levels,
+                .n_instances = static_cast<uint32_t>(m_renderer.m_instances.size()),
+                .n_batches = static_cast<uint32_t>(m_renderer.m_draw_batches.size()),
+                .occlusion = occlusion,
+                .compact = vk.config.indirect_count,
+                .padding = 0,
+            };
+
+            std::memcpy(static_cast<uint8_t*>(m_parameters.mapped()) + frame * m_parameters_frame_size, &parameters,
+                        sizeof(parameters));
+
+            m_previous_view_projection = m_renderer.m_view_projection;
+
+            VkMemoryBarrier memory_barrier{};
+            memory_barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+            memory_barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+            memory_barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+            vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_cull_pipeline);
+            vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_cull_layout, 0, 1,
+                                    &m_cull_descriptor_sets[frame], 0, nullptr);
+
+            for (uint32_t phase : {0u, 1u}) {
+                const auto n = phase == 0 ? parameters.n_instances : parameters.n_batches;
+
+                vkCmdPushConstants(command_buffer, m_cull_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(phase), &phase);
+                vkCmdDispatch(command_buffer, std::max((n + cull_group_size - 1) / cull_group_size, 1u), 1, 1);
+
+                if (phase == 0)
+                    vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memory_barrier, 0, nullptr, 0, nullptr);
+            }
+
+            memory_barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+
+            vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                 VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, 0, 1, &memory_barrier,
+                                 0, nullptr, 0, nullptr);
+
+            return {};
+        }
+    } // namespace engine
+} // namespace arbor
\ No newline at end of file
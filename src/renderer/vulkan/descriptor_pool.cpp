@@ -6,42 +6,73 @@
 namespace arbor {
     namespace engine {
         std::expected<void, std::string> renderer::pipeline::make_vk_descriptor_pool_and_sets() {
-            if (m_descriptor_set_layout)
-                return {};
+            // frames in flight may still have the previous sets bound, their pool goes away once they're done
+            if (m_descriptor_pool) {
+                m_renderer.retire([device = m_renderer.vk.device, pool = m_descriptor_pool] {
+                    vkDestroyDescriptorPool(device, pool, nullptr);
+                });
+
+                m_descriptor_pool = VK_NULL_HANDLE;
+            }
 
             VkDescriptorSetLayoutCreateInfo create_info{};
+            std::array<VkDescriptorSetLayoutBinding, 3> frame_layout_bindings{};
+            VkDescriptorSetLayoutBinding material_layout_binding{};
+
+            std::vector<VkDescriptorPoolSize> pool_sizes(3);
+
+            // set 0 is shared by every draw, the current frame's region of the ring is picked with dynamic offsets
+            frame_layout_bindings[0].binding = 0;
+            frame_layout_bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+            frame_layout_bindings[0].descriptorCount = 1;
+            frame_layout_bindings[0].stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
 
-            std::vector<VkDescriptorSetLayoutBinding> layout_bindings(2);
-            std::vector<VkDescriptorPoolSize> pool_sizes(2);
+            frame_layout_bindings[1].binding = 1;
+            frame_layout_bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+            frame_layout_bindings[1].descriptorCount = 1;
+            frame_layout_bindings[1].stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
 
-            layout_bindings[0].binding = 0;
-            layout_bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-            layout_bindings[0].descriptorCount = 1;
-            layout_bindings[0].stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+            // the transform slot of every visible instance, written by the culling stage
+            frame_layout_bindings[2].binding = 2;
+            frame_layout_bindings[2].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+            frame_layout_bindings[2].descriptorCount = 1;
+            frame_layout_bindings[2].stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
 
-            layout_bindings[1].binding = 1;
-            layout_bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-            layout_bindings[1].descriptorCount = 1;
-            layout_bindings[1].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+            material_layout_binding.binding = 0;
+            material_layout_binding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+            material_layout_binding.descriptorCount = 1;
+            material_layout_binding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
 
-            // every object has a ubo and image sampler for each frame in flight
-            const auto n_sets =
-                m_renderer.vk.sync.frames_in_flight * m_renderer.m_engine.current_scene().drawable_objects().size();
+            // every material only needs its own image sampler, textures don't change between frames
+            const auto n_material_sets = m_renderer.m_materials.size();
+            const auto n_sets = n_material_sets + 1;
 
-            pool_sizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-            pool_sizes[0].descriptorCount = n_sets;
+            pool_sizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+            pool_sizes[0].descriptorCount = 1;
 
-            pool_sizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-            pool_sizes[1].descriptorCount = n_sets;
+            pool_sizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+            pool_sizes[1].descriptorCount = 2;
+
+            pool_sizes[2].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+            pool_sizes[2].descriptorCount = std::max<uint64_t>(n_material_sets, 1);
 
             create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-            create_info.bindingCount = layout_bindings.size();
-            create_info.pBindings = layout_bindings.data();
 
-            m_renderer.m_logger->trace("creating a vulkan descriptor set layout");
-            if (auto res = vkCreateDescriptorSetLayout(m_renderer.vk.device, &create_info, nullptr, &m_descriptor_set_layout);
-                res != VK_SUCCESS)
-                return std::unexpected(fmt::format("failed to create a descriptor set layout: {}", string_VkResult(res)));
+            if (!m_frame_set_layout) {
+                m_renderer.m_logger->trace("creating vulkan descriptor set layouts");
+
+                create_info.bindingCount = frame_layout_bindings.size();
+                create_info.pBindings = frame_layout_bindings.data();
+                if (auto res = vkCreateDescriptorSetLayout(m_renderer.vk.device, &create_info, nullptr, &m_frame_set_layout);
+                    res != VK_SUCCESS)
+                    return std::unexpected(fmt::format("failed to create a descriptor set layout: {}", string_VkResult(res)));
+
+                create_info.bindingCount = 1;
+                create_info.pBindings = &material_layout_binding;
+                if (auto res = vkCreateDescriptorSetLayout(m_renderer.vk.device, &create_info, nullptr, &m_material_set_layout);
+                    res != VK_SUCCESS)
+                    return std::unexpected(fmt::format("failed to create a descriptor set layout: {}", string_VkResult(res)));
+            }
 
             VkDescriptorPoolCreateInfo pool_create_info{};
 
@@ -55,7 +86,10 @@ namespace arbor {
                 res != VK_SUCCESS)
                 return std::unexpected(fmt::format("failed to create a descriptor pool: {}", string_VkResult(res)));
 
-            std::vector<VkDescriptorSetLayout> descriptor_set_layouts(n_sets, m_descriptor_set_layout);
+            std::vector<VkDescriptorSetLayout> descriptor_set_layouts(n_sets, m_material_set_layout);
+            descriptor_set_layouts[0] = m_frame_set_layout;
+
+            std::vector<VkDescriptorSet> descriptor_sets(n_sets);
 
             VkDescriptorSetAllocateInfo allocation_info{};
 
@@ -64,54 +98,67 @@ namespace arbor {
             allocation_info.descriptorSetCount = n_sets;
             allocation_info.pSetLayouts = descriptor_set_layouts.data();
 
-            m_descriptor_sets.resize(n_sets);
-
             m_renderer.m_logger->trace("allocating {} vulkan descriptor sets", n_sets);
-            if (auto res = vkAllocateDescriptorSets(m_renderer.vk.device, &allocation_info, m_descriptor_sets.data());
+            if (auto res = vkAllocateDescriptorSets(m_renderer.vk.device, &allocation_info, descriptor_sets.data());
                 res != VK_SUCCESS)
                 return std::unexpected(fmt::format("failed to allocate descriptor sets: {}", string_VkResult(res)));
 
-            auto object_id_it = m_renderer.m_engine.current_scene().drawable_objects().begin();
-
-            for (auto i = 0ull; i < n_sets; i++) {
-                VkDescriptorBufferInfo buffer_info{};
-                VkDescriptorImageInfo image_info{};
+            m_frame_descriptor_set = descriptor_sets.front();
+            m_material_descriptor_sets.assign(descriptor_sets.begin() + 1, descriptor_sets.end());
+
+            VkWriteDescriptorSet write{};
+            std::array<VkWriteDescriptorSet, 3> frame_writes{};
+            std::array<VkDescriptorBufferInfo, 3> buffer_infos{};
+
+            buffer_infos[0].buffer = *m_renderer.vk.frame_ring.buffer();
+            buffer_infos[0].offset = 0;
+            buffer_infos[0].range = sizeof(engine::detail::camera_data);
+
+            buffer_infos[1].buffer = *m_renderer.vk.frame_ring.buffer();
+            buffer_infos[1].offset = 0;
+            buffer_infos[1].range = m_renderer.vk.frame_ring_transforms_size;
+
+            buffer_infos[2].buffer = *m_renderer.vk.frame_ring.buffer();
+            buffer_infos[2].offset = 0;
+            buffer_infos[2].range = m_renderer.vk.frame_ring_frame_size - m_renderer.vk.frame_ring_camera_size -
+                                    m_renderer.vk.frame_ring_transforms_size;
+
+            for (auto i = 0ull; i < frame_writes.size(); i++) {
+                frame_writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+                frame_writes[i].dstSet = m_frame_descriptor_set;
+                frame_writes[i].dstBinding = frame_layout_bindings[i].binding;
+                frame_writes[i].dstArrayElement = 0;
+                frame_writes[i].descriptorType = frame_layout_bindings[i].descriptorType;
+                frame_writes[i].descriptorCount = 1;
+                frame_writes[i].pBufferInfo = &buffer_infos[i];
+            }
 
-                std::vector<VkWriteDescriptorSet> writes(2);
+            vkUpdateDescriptorSets(m_renderer.vk.device, frame_writes.size(), frame_writes.data(), 0, nullptr);
 
-                buffer_info.buffer = *m_renderer.vk.uniform_buffers[i].buffer();
-                buffer_info.offset = 0;
-                buffer_info.range = sizeof(engine::detail::mvp);
+            for (auto i = 0ull; i < n_material_sets; i++) {
+                const auto material = m_renderer.m_materials[i];
+                VkDescriptorImageInfo image_info{};
 
                 image_info.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 
-                if (!m_renderer.m_textures.contains(*object_id_it))
-                    return std::unexpected(fmt::format("object {} is missing a texture", *object_id_it));
+                if (!m_renderer.m_textures.contains(material) ||
+                    !m_renderer.m_textures[material].contains(assets::texture::albedo))
+                    return std::unexpected(fmt::format("material {:#x} is missing an albedo texture", material));
 
-                auto& albedo = m_renderer.m_textures[*object_id_it][assets::texture::albedo];
+                auto& albedo = m_renderer.m_textures[material][assets::texture::albedo];
                 image_info.imageView = albedo.image_view();
                 image_info.sampler = albedo.sampler();
 
-                writes[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-                writes[0].dstSet = m_descriptor_sets[i];
-                writes[0].dstBinding = 0;
-                writes[0].dstArrayElement = 0;
-                writes[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-                writes[0].descriptorCount = 1;
-                writes[0].pBufferInfo = &buffer_info;
-
-                writes[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-                writes[1].dstSet = m_descriptor_sets[i];
-                writes[1].dstBinding = 1;
-                writes[1].dstArrayElement = 0;
-                writes[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-                writes[1].descriptorCount = 1;
-                writes[1].pImageInfo = &image_info;
-
-                vkUpdateDescriptorSets(m_renderer.vk.device, writes.size(), writes.data(), 0, nullptr);
-
-                if ((i + 1) % m_renderer.vk.sync.frames_in_flight == 0)
-                    object_id_it++;
+                write = {};
+                write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+                write.dstSet = m_material_descriptor_sets[i];
+                write.dstBinding = 0;
+                write.dstArrayElement = 0;
+                write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+                write.descriptorCount = 1;
+                write.pImageInfo = &image_info;
+
+                vkUpdateDescriptorSets(m_renderer.vk.device, 1, &write, 0, nullptr);
             }
 
             return {};
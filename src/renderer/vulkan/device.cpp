@@ -50,9 +50,24 @@ namespace arbor {
                 if (graphics_qf_it == queue_families.end() || present_qf_it == queue_families.end())
                     std::unexpected("failed to find a vulkan device");
 
+                // a transfer-only family is usually backed by the copy engines, one without graphics is the next best
+                auto transfer_qf_it = std::ranges::find_if(queue_families, [](const auto& qf) {
+                    return (qf.queueFlags & VK_QUEUE_TRANSFER_BIT) &&
+                           !(qf.queueFlags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT));
+                });
+
+                if (transfer_qf_it == queue_families.end())
+                    transfer_qf_it = std::ranges::find_if(queue_families, [](const auto& qf) {
+                        return (qf.queueFlags & VK_QUEUE_TRANSFER_BIT) && !(qf.queueFlags & VK_QUEUE_GRAPHICS_BIT);
+                    });
+
+                if (transfer_qf_it == queue_families.end())
+                    transfer_qf_it = graphics_qf_it;
+
                 detail::device_queue_family_indices qf_indices = {
                     .graphics_family = static_cast<uint32_t>(std::distance(queue_families.begin(), graphics_qf_it)),
                     .present_family = static_cast<uint32_t>(std::distance(queue_families.begin(), present_qf_it)),
+                    .transfer_family = static_cast<uint32_t>(std::distance(queue_families.begin(), transfer_qf_it)),
                 };
 
                 return {{device, features, properties, qf_indices}};
@@ -81,10 +96,38 @@ namespace arbor {
 
             m_logger->info("using '{}' as vulkan device", vk.physical_device.properties.deviceName);
 
+            if (!vk.physical_device.features.drawIndirectFirstInstance) {
+                m_logger->warn("the vulkan device doesn't support drawIndirectFirstInstance, falling back to direct draws");
+                vk.config.indirect_draws = false;
+                vk.config.gpu_culling = false;
+            }
+
+            VkPhysicalDeviceFeatures2 features{};
+            VkPhysicalDeviceVulkan12Features vulkan12_features{};
+            VkPhysicalDeviceVulkan12Features enabled_vulkan12_features{};
+
+            features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+            features.pNext = &vulkan12_features;
+            vulkan12_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+            enabled_vulkan12_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+
+            vkGetPhysicalDeviceFeatures2(vk.physical_device.handle, &features);
+
+            vk.config.indirect_count = vk.config.gpu_culling && vulkan12_features.drawIndirectCount;
+            enabled_vulkan12_features.drawIndirectCount = vk.config.indirect_count;
+
+            // uploads signal their completion on a timeline semaphore, required by every vulkan 1.2 device
+            if (!vulkan12_features.timelineSemaphore)
+                return std::unexpected("failed to create a vulkan device: timeline semaphores aren't supported");
+            enabled_vulkan12_features.timelineSemaphore = VK_TRUE;
+
+            update_occlusion_culling();
+
             VkDeviceCreateInfo create_info{};
             std::set<uint32_t> qf_set{
                 vk.physical_device.queue_family_indices.graphics_family,
                 vk.physical_device.queue_family_indices.present_family,
+                vk.physical_device.queue_family_indices.transfer_family,
             };
 
             std::vector<VkDeviceQueueCreateInfo> queue_create_infos;
@@ -107,6 +150,7 @@ namespace arbor {
             }
 
             create_info.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+            create_info.pNext = &enabled_vulkan12_features;
             create_info.queueCreateInfoCount = queue_create_infos.size();
             create_info.pQueueCreateInfos = queue_create_infos.data();
             create_info.pEnabledFeatures = &vk.physical_device.features;
@@ -124,8 +168,29 @@ namespace arbor {
 
             vkGetDeviceQueue(vk.device, vk.physical_device.queue_family_indices.graphics_family, 0, &vk.graphics_queue);
             vkGetDeviceQueue(vk.device, vk.physical_device.queue_family_indices.present_family, 0, &vk.present_queue);
+            vkGetDeviceQueue(vk.device, vk.physical_device.queue_family_indices.transfer_family, 0, &vk.transfer_queue);
+
+            vk.allocator.init(vk.device, vk.physical_device.handle, m_logger);
 
             return {};
         }
+
+        void renderer::update_occlusion_culling() {
+            // the reduce pass samples the multisampled depth buffer, only 1x and 4x are guaranteed to be sampleable
+            const auto& limits = vk.physical_device.properties.limits;
+            const auto samples = static_cast<uint32_t>(vk.config.sample_count);
+            const auto requested = vk.config.occlusion_culling_requested && vk.config.gpu_culling;
+            const auto occlusion_culling = requested && (limits.sampledImageDepthSampleCounts & vk.config.sample_count) != 0;
+
+            if (requested && occlusion_culling != vk.config.occlusion_culling) {
+                if (occlusion_culling)
+                    m_logger->info("occlusion culling is enabled at {}x MSAA", samples);
+                else
+                    m_logger->warn("the vulkan device can't sample {}x multisampled depth, occlusion culling is disabled",
+                                   samples);
+            }
+
+            vk.config.occlusion_culling = occlusion_culling;
+        }
     } // namespace engine
 } // namespace arbor
\ No newline at end of file
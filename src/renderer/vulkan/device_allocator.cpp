@@ -0,0 +1,290 @@
+#include "arbor/components/renderer.hpp"
+
+#include "vulkan/vk_enum_string_helper.h"
+#include <algorithm>
+#include <optional>
+#include <vulkan/vulkan_core.h>
+
+namespace arbor {
+    namespace engine {
+        static constexpr uint64_t align_up(uint64_t value, uint64_t alignment) {
+            return alignment ? (value + alignment - 1) / alignment * alignment : value;
+        }
+
+        renderer::device_allocator::~device_allocator() {
+            destroy();
+        }
+
+        void renderer::device_allocator::init(VkDevice device, VkPhysicalDevice physical_device,
+                                              std::shared_ptr<spdlog::logger> logger) {
+            m_device = device;
+            m_physical_device = physical_device;
+            m_logger = std::move(logger);
+
+            vkGetPhysicalDeviceMemoryProperties(m_physical_device, &m_memory_properties);
+        }
+
+        void renderer::device_allocator::destroy() {
+            std::scoped_lock lock(m_mutex);
+
+            for (auto& pool : m_pools) {
+                for (auto& block : pool) {
+                    if (block->allocations && m_logger)
+                        m_logger->warn("freeing a memory block with {} live allocations", block->allocations);
+
+                    if (block->mapped)
+                        vkUnmapMemory(m_device, block->memory);
+
+                    if (block->memory && m_device)
+                        vkFreeMemory(m_device, block->memory, nullptr);
+                }
+
+                pool.clear();
+            }
+        }
+
+        std::expected<uint32_t, std::string>
+        renderer::device_allocator::find_memory_type(uint32_t type_bits, VkMemoryPropertyFlags properties) const {
+            for (auto i = 0u; i < m_memory_properties.memoryTypeCount; i++) {
+                if ((type_bits & (1 << i)) && (m_memory_properties.memoryTypes[i].propertyFlags & properties) == properties)
+                    return i;
+            }
+
+            return std::unexpected(fmt::format("no memory type supports the requested properties ({:#x})", properties));
+        }
+
+        std::expected<renderer::device_allocator::block*, std::string>
+        renderer::device_allocator::make_block(uint32_t pool, uint64_t size, uint64_t min_size, bool dedicated) {
+            const auto memory_type = pool / 2;
+
+            VkMemoryAllocateInfo allocation_info{};
+            allocation_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+            allocation_info.memoryTypeIndex = memory_type;
+
+            auto out = std::make_unique<block>();
+
+            // fall back to smaller blocks before giving up, the heap might just be fragmented. never below what the
+            // allocation that asked for the block needs though
+            const auto smallest = std::max(min_size, m_block_size / 8);
+
+            for (auto block_size = size;; block_size /= 2) {
+                allocation_info.allocationSize = block_size;
+
+                auto res = vkAllocateMemory(m_device, &allocation_info, nullptr, &out->memory);
+                if (res == VK_SUCCESS) {
+                    out->size = block_size;
+                    break;
+                }
+
+                if (dedicated || block_size / 2 < smallest || res != VK_ERROR_OUT_OF_DEVICE_MEMORY)
+                    return std::unexpected(fmt::format("failed to allocate a memory block: {}", string_VkResult(res)));
+            }
+
+            if (m_memory_properties.memoryTypes[memory_type].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+                if (auto res = vkMapMemory(m_device, out->memory, 0, VK_WHOLE_SIZE, 0, &out->mapped); res != VK_SUCCESS) {
+                    vkFreeMemory(m_device, out->memory, nullptr);
+                    return std::unexpected(fmt::format("failed to map a memory block: {}", string_VkResult(res)));
+                }
+            }
+
+            out->dedicated = dedicated;
+            out->free_ranges.emplace(0, out->size);
+
+            if (m_logger)
+                m_logger->trace("allocated a {}memory block of {} bytes (memory type {})", dedicated ? "dedicated " : "",
+                                out->size, memory_type);
+
+            m_pools[pool].push_back(std::move(out));
+            return m_pools[pool].back().get();
+        }
+
+        void renderer::device_allocator::free_block(uint32_t pool, device_allocator::block* block) {
+            auto it = std::ranges::find_if(m_pools[pool], [&](const auto& other) { return other.get() == block; });
+            if (it == m_pools[pool].end())
+                return;
+
+            if (block->mapped)
+                vkUnmapMemory(m_device, block->memory);
+
+            vkFreeMemory(m_device, block->memory, nullptr);
+            m_pools[pool].erase(it);
+        }
+
+        std::expected<renderer::device_allocator::allocation, std::string>
+        renderer::device_allocator::allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties,
+                                             device_allocator::ekind kind) {
+            auto memory_type = find_memory_type(requirements.memoryTypeBits, properties);
+            if (!memory_type)
+                return std::unexpected(memory_type.error());
+
+            const auto pool = *memory_type * 2 + kind;
+
+            std::scoped_lock lock(m_mutex);
+
+            auto sub_allocate = [&](block& block) -> std::optional<allocation> {
+                for (auto it = block.free_ranges.begin(); it != block.free_ranges.end(); it++) {
+                    auto [range_offset, range_size] = *it;
+                    auto offset = align_up(range_offset, requirements.alignment);
+
+                    if (offset + requirements.size > range_offset + range_size)
+                        continue;
+
+                    block.free_ranges.erase(it);
+
+                    if (offset > range_offset)
+                        block.free_ranges.emplace(range_offset, offset - range_offset);
+
+                    if (offset + requirements.size < range_offset + range_size)
+                        block.free_ranges.emplace(offset + requirements.size,
+                                                  range_offset + range_size - offset - requirements.size);
+
+                    block.allocations++;
+                    block.bytes_used += requirements.size;
+
+                    return allocation{
+                        .memory = block.memory,
+                        .offset = offset,
+                        .size = requirements.size,
+                        .mapped = block.mapped ? static_cast<uint8_t*>(block.mapped) + offset : nullptr,
+                        .pool = pool,
+                    };
+                }
+
+                return std::nullopt;
+            };
+
+            // anything bigger than half a block would mostly waste it
+            if (requirements.size > m_block_size / 2) {
+                auto block = make_block(pool, requirements.size, requirements.size, true);
+                if (!block)
+                    return std::unexpected(block.error());
+                return *sub_allocate(**block);
+            }
+
+            for (auto& block : m_pools[pool]) {
+                if (block->dedicated)
+                    continue;
+
+                if (auto res = sub_allocate(*block))
+                    return *res;
+            }
+
+            auto block = make_block(pool, m_block_size, requirements.size, false);
+            if (!block)
+                return std::unexpected(block.error());
+
+            if (auto res = sub_allocate(**block))
+                return *res;
+
+            free_block(pool, *block);
+            return std::unexpected(fmt::format("failed to sub-allocate {} bytes from a fresh memory block", requirements.size));
+        }
+
+        std::expected<renderer::device_allocator::allocation, std::string>
+        renderer::device_allocator::allocate(VkBuffer buffer, VkMemoryPropertyFlags properties) {
+            VkMemoryRequirements memory_requirements;
+            vkGetBufferMemoryRequirements(m_device, buffer, &memory_requirements);
+
+            auto res = allocate(memory_requirements, properties, ekind::linear);
+            if (!res)
+                return res;
+
+            if (auto bind_res = vkBindBufferMemory(m_device, buffer, res->memory, res->offset); bind_res != VK_SUCCESS) {
+                free(*res);
+                return std::unexpected(fmt::format("failed to bind buffer memory: {}", string_VkResult(bind_res)));
+            }
+
+            return res;
+        }
+
+        std::expected<renderer::device_allocator::allocation, std::string>
+        renderer::device_allocator::allocate(VkImage image, VkMemoryPropertyFlags properties) {
+            VkMemoryRequirements memory_requirements;
+            vkGetImageMemoryRequirements(m_device, image, &memory_requirements);
+
+            auto res = allocate(memory_requirements, properties, ekind::optimal);
+            if (!res)
+                return res;
+
+            if (auto bind_res = vkBindImageMemory(m_device, image, res->memory, res->offset); bind_res != VK_SUCCESS) {
+                free(*res);
+                return std::unexpected(fmt::format("failed to bind image memory: {}", string_VkResult(bind_res)));
+            }
+
+            return res;
+        }
+
+        void renderer::device_allocator::free(allocation& memory) {
+            if (!memory.memory || memory.pool >= m_pools.size())
+                return;
+
+            std::scoped_lock lock(m_mutex);
+
+            auto& pool = m_pools[memory.pool];
+            auto block_it = std::ranges::find_if(pool, [&](const auto& block) { return block->memory == memory.memory; });
+
+            if (block_it == pool.end()) {
+                memory = {};
+                return;
+            }
+
+            auto& block = **block_it;
+            block.allocations--;
+            block.bytes_used -= memory.size;
+
+            auto offset = memory.offset;
+            auto size = memory.size;
+
+            // merge with the neighbouring free ranges so the block doesn't fragment over time
+            if (auto next = block.free_ranges.lower_bound(offset);
+                next != block.free_ranges.end() && next->first == offset + size) {
+                size += next->second;
+                block.free_ranges.erase(next);
+            }
+
+            if (auto next = block.free_ranges.lower_bound(offset); next != block.free_ranges.begin()) {
+                auto prev = std::prev(next);
+                if (prev->first + prev->second == offset) {
+                    offset = prev->first;
+                    size += prev->second;
+                    block.free_ranges.erase(prev);
+                }
+            }
+
+            block.free_ranges.emplace(offset, size);
+
+            // keep one empty block per pool around, scene reloads free and reallocate everything at once
+            if (!block.allocations && (block.dedicated || pool.size() > 1))
+                free_block(memory.pool, &block);
+
+            memory = {};
+        }
+
+        std::vector<renderer::device_allocator::heap_statistics> renderer::device_allocator::statistics() {
+            std::vector<heap_statistics> out(m_memory_properties.memoryHeapCount);
+
+            for (auto i = 0u; i < m_memory_properties.memoryHeapCount; i++) {
+                out[i].flags = m_memory_properties.memoryHeaps[i].flags;
+                out[i].heap_size = m_memory_properties.memoryHeaps[i].size;
+            }
+
+            std::scoped_lock lock(m_mutex);
+
+            for (auto pool = 0u; pool < m_pools.size(); pool++) {
+                if (pool / 2 >= m_memory_properties.memoryTypeCount)
+                    break;
+
+                auto& heap = out[m_memory_properties.memoryTypes[pool / 2].heapIndex];
+
+                for (const auto& block : m_pools[pool]) {
+                    heap.block_count++;
+                    heap.allocation_count += block->allocations;
+                    heap.bytes_reserved += block->size;
+                    heap.bytes_used += block->bytes_used;
+                }
+            }
+
+            return out;
+        }
+    } // namespace engine
+} // namespace arbor
\ No newline at end of file
@@ -2,219 +2,217 @@
 
 #include "arbor/assets/model.hpp"
 #include "vulkan/vk_enum_string_helper.h"
+#include <algorithm>
+#include <bit>
 #include <vulkan/vulkan_core.h>
 
 namespace arbor {
     namespace engine {
         std::expected<void, std::string> renderer::device_buffer::make(uint64_t size, VkBufferUsageFlags usage,
-                                                                       VkMemoryPropertyFlags properties, VkDevice device,
-                                                                       VkPhysicalDevice physical_device, bool keep_mapped) {
+                                                                       VkMemoryPropertyFlags properties,
+                                                                       renderer::device_allocator& allocator,
+                                                                       std::span<const uint32_t> queue_families) {
             VkBufferCreateInfo create_info{};
-            VkMemoryAllocateInfo allocation_info{};
 
-            m_keep_mapped = keep_mapped;
-            m_device = device;
-            m_physical_device = physical_device;
+            m_allocator = &allocator;
             m_size = size;
             m_usage = usage;
 
             create_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
             create_info.size = size;
             create_info.usage = usage;
-            create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+            create_info.sharingMode = queue_families.size() > 1 ? VK_SHARING_MODE_CONCURRENT : VK_SHARING_MODE_EXCLUSIVE;
+            create_info.queueFamilyIndexCount = queue_families.size() > 1 ? queue_families.size() : 0;
+            create_info.pQueueFamilyIndices = queue_families.data();
 
-            if (auto res = vkCreateBuffer(m_device, &create_info, nullptr, &m_buffer); res != VK_SUCCESS)
+            if (auto res = vkCreateBuffer(m_allocator->device(), &create_info, nullptr, &m_buffer); res != VK_SUCCESS)
                 return std::unexpected(fmt::format("failed to create buffer: {}", string_VkResult(res)));
 
-            VkMemoryRequirements memory_requirements;
-            vkGetBufferMemoryRequirements(m_device, m_buffer, &memory_requirements);
+            if (auto res = m_allocator->allocate(m_buffer, properties); res)
+                m_allocation = *res;
+            else
+                return std::unexpected(res.error());
 
-            VkPhysicalDeviceMemoryProperties memory_properties;
-            vkGetPhysicalDeviceMemoryProperties(m_physical_device, &memory_properties);
-
-            uint32_t memory_type = memory_requirements.memoryTypeBits;
-
-            auto memory_type_idx = 0u;
-            for (memory_type_idx = 0u; memory_type_idx < memory_properties.memoryTypeCount; memory_type_idx++) {
-                if ((memory_type & (1 << memory_type_idx)) &&
-                    (memory_properties.memoryTypes[memory_type_idx].propertyFlags & properties))
-                    break;
-            }
-
-            allocation_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-            allocation_info.allocationSize = memory_requirements.size;
-            allocation_info.memoryTypeIndex = memory_type_idx;
-
-            if (auto res = vkAllocateMemory(m_device, &allocation_info, nullptr, &m_memory); res != VK_SUCCESS)
-                return std::unexpected(fmt::format("failed to allocate buffer memory: {}", string_VkResult(res)));
+            return {};
+        }
 
-            if (auto res = vkBindBufferMemory(m_device, m_buffer, m_memory, 0); res != VK_SUCCESS)
-                return std::unexpected(fmt::format("failed to bind buffer memory: {}", string_VkResult(res)));
+        std::expected<void, std::string> renderer::device_buffer::write_data(const void* bytes, uint64_t size) {
+            if (!m_allocation.mapped)
+                return std::unexpected("failed to write to a device buffer: memory is not host visible");
 
-            if (m_keep_mapped) {
-                if (auto res = vkMapMemory(m_device, m_memory, 0, size, 0, &m_mapped); res != VK_SUCCESS)
-                    return std::unexpected(fmt::format("failed to map device buffer memory: {}", string_VkResult(res)));
-            }
+            std::memcpy(m_allocation.mapped, bytes, size);
 
             return {};
         }
 
-        std::expected<void, std::string> renderer::device_buffer::write_data(const void* bytes, uint64_t size,
-                                                                             VkQueue transfer_queue, VkCommandPool command_pool) {
-            if (!transfer_queue || !command_pool) {
-                if (!m_keep_mapped || !m_mapped) {
-                    if (auto res = vkMapMemory(m_device, m_memory, 0, size, 0, &m_mapped); res != VK_SUCCESS)
-                        return std::unexpected(fmt::format("failed to map device buffer memory: {}", string_VkResult(res)));
-                }
-
-                std::memcpy(m_mapped, bytes, size);
-
-                if (!m_keep_mapped) {
-                    vkUnmapMemory(m_device, m_memory);
-                    m_mapped = nullptr;
-                }
+        void renderer::device_buffer::free() {
+            if (!m_allocator)
+                return;
 
-                return {};
+            if (m_buffer) {
+                vkDestroyBuffer(m_allocator->device(), m_buffer, nullptr);
+                m_buffer = VK_NULL_HANDLE;
             }
 
-            renderer::device_buffer staging_buffer;
-            staging_buffer.make(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, m_device,
-                                m_physical_device);
+            m_allocator->free(m_allocation);
+        }
 
-            staging_buffer.write_data(bytes, size);
+        std::function<void()> renderer::device_buffer::release() {
+            auto destroy = [allocator = m_allocator, buffer = m_buffer, allocation = m_allocation]() mutable {
+                if (!allocator)
+                    return;
 
-            free();
-            make(size, VK_BUFFER_USAGE_TRANSFER_DST_BIT | m_usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_device,
-                 m_physical_device);
+                if (buffer)
+                    vkDestroyBuffer(allocator->device(), buffer, nullptr);
 
-            VkSubmitInfo submit_info{};
-            VkCommandBufferBeginInfo begin_info{};
-            VkCommandBufferAllocateInfo command_buffer_allocate_info{};
+                allocator->free(allocation);
+            };
 
-            command_buffer_allocate_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-            command_buffer_allocate_info.commandBufferCount = 1;
-            command_buffer_allocate_info.commandPool = command_pool;
-            command_buffer_allocate_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+            m_buffer = VK_NULL_HANDLE;
+            m_allocation = {};
+            m_size = 0;
 
-            VkCommandBuffer command_buffer;
-            if (auto res = vkAllocateCommandBuffers(m_device, &command_buffer_allocate_info, &command_buffer); res != VK_SUCCESS)
-                return std::unexpected(fmt::format("failed to allocate a staging command buffer", string_VkResult(res)));
-
-            begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-            begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+            return destroy;
+        }
 
-            if (auto res = vkBeginCommandBuffer(command_buffer, &begin_info); res != VK_SUCCESS)
-                return std::unexpected(fmt::format("failed to begin a staging command buffer", string_VkResult(res)));
+        renderer::device_buffer::~device_buffer() {
+            free();
+        }
 
-            VkBufferCopy copy{};
-            copy.size = size;
+        std::expected<void, std::string> renderer::upload_meshes() {
+            std::vector<assets::vertex_3d> vertices;
+            std::vector<uint32_t> indices;
 
-            vkCmdCopyBuffer(command_buffer, staging_buffer.m_buffer, m_buffer, 1, &copy);
+            for (auto i = m_geometry.n_uploaded_meshes; i < m_meshes.size(); i++) {
+                const auto& model = m_engine.current_scene().asset_library().mesh(m_meshes[i]);
 
-            if (auto res = vkEndCommandBuffer(command_buffer); res != VK_SUCCESS)
-                return std::unexpected(fmt::format("failed to end staging command buffer: {}", string_VkResult(res)));
+                vertices.append_range(model.vertices);
+                indices.append_range(model.indices);
+            }
 
-            submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-            submit_info.commandBufferCount = 1;
-            submit_info.pCommandBuffers = &command_buffer;
+            m_logger->trace("uploading {} meshes ({} vertices, {} indices)", m_meshes.size() - m_geometry.n_uploaded_meshes,
+                            vertices.size(), indices.size());
 
-            if (auto res = vkQueueSubmit(transfer_queue, 1, &submit_info, VK_NULL_HANDLE); res != VK_SUCCESS)
-                return std::unexpected(fmt::format("failed to stage buffer to GPU: {}", string_VkResult(res)));
+            if (auto res = append_to_buffer(vk.vertex_buffer, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                                            m_geometry.n_uploaded_vertices * sizeof(assets::vertex_3d), vertices.data(),
+                                            vertices.size() * sizeof(assets::vertex_3d));
+                !res)
+                return res;
 
-            vkQueueWaitIdle(transfer_queue);
+            if (auto res = append_to_buffer(vk.index_buffer, VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+                                            m_geometry.n_uploaded_indices * sizeof(uint32_t), indices.data(),
+                                            indices.size() * sizeof(uint32_t));
+                !res)
+                return res;
 
-            vkFreeCommandBuffers(m_device, command_pool, 1, &command_buffer);
+            m_geometry.n_uploaded_meshes = m_meshes.size();
+            m_geometry.n_uploaded_vertices += vertices.size();
+            m_geometry.n_uploaded_indices += indices.size();
 
             return {};
         }
 
-        void renderer::device_buffer::free() {
-            if (m_mapped) {
-                vkUnmapMemory(m_device, m_memory);
-                m_mapped = nullptr;
-            }
+        void renderer::retire(std::function<void()> destroy) {
+            m_retired[vk.sync.current_frame].push_back(std::move(destroy));
+        }
 
-            if (m_buffer && m_device) {
-                vkDestroyBuffer(m_device, m_buffer, nullptr);
-                m_buffer = VK_NULL_HANDLE;
-            }
+        void renderer::release_retired(uint32_t frame) {
+            for (auto& destroy : m_retired[frame])
+                destroy();
 
-            if (m_memory && m_device) {
-                vkFreeMemory(m_device, m_memory, nullptr);
-                m_memory = VK_NULL_HANDLE;
-            }
+            m_retired[frame].clear();
         }
 
-        renderer::device_buffer::~device_buffer() {
-            free();
-        }
+        std::expected<void, std::string> renderer::append_to_buffer(renderer::device_buffer& buffer, VkBufferUsageFlags usage,
+                                                                    uint64_t used, const void* bytes, uint64_t size) {
+            constexpr uint64_t min_capacity = 1 << 16;
 
-        std::expected<void, std::string> renderer::make_vertex_buffer() {
-            uint64_t size = 0;
-            std::vector<assets::vertex_3d> vertices;
-            for (auto id : m_engine.current_scene().drawable_objects()) {
-                size += m_engine.current_scene().asset_library()[id].model.vertices.size() *
-                        sizeof(*m_engine.current_scene().asset_library()[id].model.vertices.begin());
+            if (!*buffer.buffer() || used + size > buffer.size()) {
+                const auto capacity = std::max({used + size, buffer.size() * 2, min_capacity});
+                const auto previous = *buffer.buffer();
 
-                vertices.append_range(m_engine.current_scene().asset_library()[id].model.vertices);
-            }
+                // frames in flight keep drawing from the old buffer and the upload queue copies its contents over,
+                // it's destroyed once both are done with it
+                if (previous)
+                    retire([this, destroy = buffer.release()]() mutable { m_uploads.release(std::move(destroy)); });
 
-            m_logger->trace("allocating a vertex buffer of {} vertices ({} bytes)", vertices.size(), size);
+                m_logger->trace("growing a device buffer to {} bytes", capacity);
 
-            if (auto res = vk.vertex_buffer.make(size, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-                                                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                                                 vk.device, vk.physical_device.handle);
-                !res) {
-                return res;
+                if (auto res = buffer.make(capacity,
+                                           usage | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                           VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, vk.allocator, m_uploads.queue_families());
+                    !res)
+                    return res;
+
+                if (previous && used) {
+                    const VkBufferCopy region{.srcOffset = 0, .dstOffset = 0, .size = used};
+                    if (auto res = m_uploads.copy_buffer(previous, *buffer.buffer(), region); !res)
+                        return res;
+                }
             }
 
-            if (auto res = vk.vertex_buffer.write_data(vertices.data(), size, vk.graphics_queue, vk.command_pool); !res)
-                return res;
+            if (!size)
+                return {};
 
-            return {};
+            // the appended range isn't read by any frame in flight, so it can be written without waiting on them
+            return m_uploads.copy_to_buffer(bytes, size, *buffer.buffer(), used);
         }
 
-        std::expected<void, std::string> renderer::make_index_buffer() {
-            uint64_t size = 0;
-            std::vector<uint32_t> indices;
-            for (auto id : m_engine.current_scene().drawable_objects()) {
-                size += m_engine.current_scene().asset_library()[id].model.indices.size() *
-                        sizeof(*m_engine.current_scene().asset_library()[id].model.indices.begin());
-
-                indices.append_range(m_engine.current_scene().asset_library()[id].model.indices);
+        std::expected<void, std::string> renderer::make_uniform_buffers() {
+            // both halves of a region are bound with dynamic offsets, so they have to satisfy both alignments
+            const auto alignment = std::max(vk.physical_device.properties.limits.minUniformBufferOffsetAlignment,
+                                            vk.physical_device.properties.limits.minStorageBufferOffsetAlignment);
+            const auto align = [&](uint64_t size) { return (size + alignment - 1) / alignment * alignment; };
+
+            // regions are sized for a power of two of objects, there's room left for the ones added later on
+            const auto n_objects = std::bit_ceil(std::max<uint64_t>(m_engine.current_scene().drawable_objects().size(), 1));
+            vk.frame_ring_capacity = n_objects;
+
+            vk.frame_ring_camera_size = align(sizeof(engine::detail::camera_data));
+            vk.frame_ring_transforms_size = align(n_objects * sizeof(glm::mat4));
+            vk.frame_ring_frame_size =
+                vk.frame_ring_camera_size + vk.frame_ring_transforms_size + align(n_objects * sizeof(uint32_t));
+
+            m_logger->trace("allocating a frame ring of {} transforms per frame ({} bytes)", n_objects,
+                            vk.frame_ring_frame_size * vk.sync.frames_in_flight);
+
+            if (auto res = vk.frame_ring.make(vk.frame_ring_frame_size * vk.sync.frames_in_flight,
+                                              VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                              VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                              vk.allocator);
+                !res) {
+                return res;
             }
 
-            m_logger->trace("allocating an index buffer of {} vertices ({} bytes)", indices.size(), size);
+            return update_ubos();
+        }
 
-            if (auto res = vk.index_buffer.make(size, VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
-                                                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                                                vk.device, vk.physical_device.handle);
-                !res)
-                return res;
+        std::expected<void, std::string> renderer::make_indirect_buffer() {
+            const auto alignment = vk.physical_device.properties.limits.minStorageBufferOffsetAlignment;
+            const auto align = [&](uint64_t size) { return (size + alignment - 1) / alignment * alignment; };
 
-            if (auto res = vk.index_buffer.write_data(indices.data(), size, vk.graphics_queue, vk.command_pool); !res)
-                return res;
+            const auto n_batches = std::bit_ceil(std::max<uint64_t>(m_draw_batches.size(), 1));
+            const auto n_materials = std::bit_ceil(std::max<uint64_t>(m_materials.size(), 1));
 
-            return {};
-        }
+            vk.indirect_batch_capacity = n_batches;
+            vk.indirect_material_capacity = n_materials;
 
-        std::expected<void, std::string> renderer::make_uniform_buffers() {
-            auto size = sizeof(engine::detail::mvp);
+            // the culling stage binds every section on its own, so each of them starts at an aligned offset
+            vk.indirect_compacted_offset = align(n_batches * sizeof(VkDrawIndexedIndirectCommand));
+            vk.indirect_counts_offset = vk.indirect_compacted_offset + align(n_batches * sizeof(VkDrawIndexedIndirectCommand));
+            vk.indirect_frame_size = vk.indirect_counts_offset + align(n_materials * sizeof(uint32_t));
 
-            vk.uniform_buffers.resize(vk.sync.frames_in_flight * m_engine.current_scene().drawable_objects().size());
+            m_logger->trace("allocating an indirect buffer of {} draws per frame ({} bytes)", n_batches,
+                            vk.indirect_frame_size * vk.sync.frames_in_flight);
 
-            for (auto& buffer : vk.uniform_buffers) {
-                if (auto res = buffer.make(size, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-                                           VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, vk.device,
-                                           vk.physical_device.handle, true);
-                    !res) {
-                    return res;
-                }
+            if (auto res = vk.indirect_buffer.make(vk.indirect_frame_size * vk.sync.frames_in_flight,
+                                                   VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                                   VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                                   vk.allocator);
+                !res) {
+                return res;
             }
 
-            update_ubos();
-
             return {};
         }
     } // namespace engine
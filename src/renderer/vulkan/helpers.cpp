@@ -4,14 +4,15 @@
 
 namespace arbor {
     namespace engine {
-        std::expected<std::tuple<VkImage, VkImageView, VkDeviceMemory>, std::string>
+        std::expected<std::tuple<VkImage, VkImageView, renderer::device_allocator::allocation>, std::string>
         renderer::make_image(uint32_t width, uint32_t height, VkFormat format, VkImageUsageFlags usage,
                              VkImageAspectFlags aspect_mask, VkMemoryPropertyFlags memory_props,
-                             VkSampleCountFlagBits sample_count) {
+                             VkSampleCountFlagBits sample_count, std::span<const uint32_t> queue_families,
+                             uint32_t mip_levels) {
 
             VkImage image;
             VkImageView view;
-            VkDeviceMemory memory;
+            renderer::device_allocator::allocation memory;
 
             VkImageCreateInfo create_info{};
             VkImageViewCreateInfo view_create_info{};
@@ -22,11 +23,13 @@ namespace arbor {
             create_info.extent.width = width;
             create_info.extent.height = height;
             create_info.extent.depth = 1;
-            create_info.mipLevels = 1;
+            create_info.mipLevels = mip_levels;
             create_info.arrayLayers = 1;
             create_info.format = format;
             create_info.tiling = VK_IMAGE_TILING_OPTIMAL;
-            create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+            create_info.sharingMode = queue_families.size() > 1 ? VK_SHARING_MODE_CONCURRENT : VK_SHARING_MODE_EXCLUSIVE;
+            create_info.queueFamilyIndexCount = queue_families.size() > 1 ? queue_families.size() : 0;
+            create_info.pQueueFamilyIndices = queue_families.data();
             create_info.usage = usage;
             create_info.samples = sample_count;
 
@@ -34,38 +37,20 @@ namespace arbor {
                 return std::unexpected(
                     fmt::format("failed to create a vulkan image for texture asset: {}", string_VkResult(res)));
 
-            VkMemoryRequirements memory_requirements;
-            vkGetImageMemoryRequirements(vk.device, image, &memory_requirements);
-
-            VkPhysicalDeviceMemoryProperties memory_properties;
-            vkGetPhysicalDeviceMemoryProperties(vk.physical_device.handle, &memory_properties);
-
-            auto memory_type_idx = 0u;
-            for (memory_type_idx = 0u; memory_type_idx < memory_properties.memoryTypeCount; memory_type_idx++) {
-                if ((memory_requirements.memoryTypeBits & (1 << memory_type_idx)) &&
-                    (memory_properties.memoryTypes[memory_type_idx].propertyFlags & memory_props))
-                    break;
+            if (auto res = vk.allocator.allocate(image, memory_props); res) {
+                memory = *res;
+            } else {
+                vkDestroyImage(vk.device, image, nullptr);
+                return std::unexpected(fmt::format("failed to allocate device memory for texture asset: {}", res.error()));
             }
 
-            VkMemoryAllocateInfo allocation_info{};
-            allocation_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-            allocation_info.allocationSize = memory_requirements.size;
-            allocation_info.memoryTypeIndex = memory_type_idx;
-
-            if (auto res = vkAllocateMemory(vk.device, &allocation_info, nullptr, &memory); res != VK_SUCCESS)
-                return std::unexpected(
-                    fmt::format("failed to allocate device memory for texture asset: {}", string_VkResult(res)));
-
-            if (auto res = vkBindImageMemory(vk.device, image, memory, 0); res != VK_SUCCESS)
-                return std::unexpected(fmt::format("failed to bind texture memory to vulkan image: {}", string_VkResult(res)));
-
             view_create_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
             view_create_info.image = image;
             view_create_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
             view_create_info.format = format;
             view_create_info.subresourceRange.aspectMask = aspect_mask;
             view_create_info.subresourceRange.layerCount = 1;
-            view_create_info.subresourceRange.levelCount = 1;
+            view_create_info.subresourceRange.levelCount = mip_levels;
 
             if (auto res = vkCreateImageView(vk.device, &view_create_info, nullptr, &view); res != VK_SUCCESS)
                 return std::unexpected(
@@ -105,6 +90,12 @@ namespace arbor {
 
                 src_stage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
                 dst_stage = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+            } else if (old_layout == VK_IMAGE_LAYOUT_UNDEFINED && new_layout == VK_IMAGE_LAYOUT_GENERAL) {
+                memory_barrier.srcAccessMask = 0;
+                memory_barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+                src_stage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+                dst_stage = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
             }
 
             memory_barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
@@ -114,7 +105,7 @@ namespace arbor {
             memory_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
             memory_barrier.image = image;
             memory_barrier.subresourceRange.aspectMask = aspect_mask;
-            memory_barrier.subresourceRange.levelCount = 1;
+            memory_barrier.subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
             memory_barrier.subresourceRange.layerCount = 1;
 
             vkCmdPipelineBarrier(*command_buffer, src_stage, dst_stage, 0, 0, nullptr, 0, nullptr, 1, &memory_barrier);
@@ -1,7 +1,9 @@
 #include "arbor/components/renderer.hpp"
+#include <algorithm>
 #include <ranges>
 #include <vulkan/vulkan_core.h>
 
+#include "arbor/hash.hpp"
 #include "vulkan/vk_enum_string_helper.h"
 
 namespace arbor {
@@ -9,27 +11,53 @@ namespace arbor {
         std::expected<void, std::string> renderer::make_vk_pipeline() {
             m_pipelines.emplace_back(*this);
 
-            if (auto res = m_pipelines.back().bind_shader(m_engine.current_scene().vertex_shader(), shader::vertex); !res)
-                return res;
-
-            if (auto res = m_pipelines.back().bind_shader(m_engine.current_scene().fragment_shader(), shader::fragment); !res)
-                return res;
-
-            if (auto res = m_pipelines.back().reload(); !res)
-                return res;
+            // the scene's own shaders are variant 0, materials without shaders of their own are drawn with them
+            m_pipelines.back().variant_index({
+                {shader::vertex, m_engine.current_scene().vertex_shader()},
+                {shader::fragment, m_engine.current_scene().fragment_shader()},
+            });
 
+            // the swapchain reloads the pipeline as soon as it knows the formats, that's when it's first built
             return {};
         }
 
+        void renderer::reload_changed_shaders() {
+            const auto changed = m_shader_watcher.poll();
+            if (changed.empty())
+                return;
+
+            for (const auto& path : changed)
+                m_logger->info("{} changed", path.string());
+
+            // only variants using one of the changed files are rebuilt, and only once however many of their stages
+            // changed. a build that fails to compile leaves the pipeline it would've replaced in use
+            for (auto& pipeline : m_pipelines) {
+                for (auto variant = 0u; variant < pipeline.variant_count(); variant++) {
+                    if (std::ranges::any_of(changed, [&](const auto& path) { return pipeline.uses_shader(variant, path); }))
+                        pipeline.rebuild(variant);
+                }
+            }
+        }
+
         renderer::pipeline::~pipeline() {
-            if (m_pipeline)
-                vkDestroyPipeline(m_renderer.vk.device, m_pipeline, nullptr);
+            wait_for_builds();
+
+            for (auto& build : m_builds)
+                if (build->pipeline)
+                    vkDestroyPipeline(m_renderer.vk.device, build->pipeline, nullptr);
+
+            for (auto& variant : m_variants)
+                if (variant.handle)
+                    vkDestroyPipeline(m_renderer.vk.device, variant.handle, nullptr);
 
             if (m_descriptor_pool)
                 vkDestroyDescriptorPool(m_renderer.vk.device, m_descriptor_pool, nullptr);
 
-            if (m_descriptor_set_layout)
-                vkDestroyDescriptorSetLayout(m_renderer.vk.device, m_descriptor_set_layout, nullptr);
+            if (m_frame_set_layout)
+                vkDestroyDescriptorSetLayout(m_renderer.vk.device, m_frame_set_layout, nullptr);
+
+            if (m_material_set_layout)
+                vkDestroyDescriptorSetLayout(m_renderer.vk.device, m_material_set_layout, nullptr);
 
             if (m_pipeline_layout)
                 vkDestroyPipelineLayout(m_renderer.vk.device, m_pipeline_layout, nullptr);
@@ -38,23 +66,31 @@ namespace arbor {
                 vkDestroyRenderPass(m_renderer.vk.device, m_render_pass, nullptr);
         }
 
-        std::expected<void, std::string> renderer::pipeline::reload(bool rebuild) {
+        std::expected<void, std::string> renderer::pipeline::reload(bool rebuild_pipeline) {
             if (m_descriptor_pool) {
                 vkDestroyDescriptorPool(m_renderer.vk.device, m_descriptor_pool, nullptr);
                 m_descriptor_pool = VK_NULL_HANDLE;
             }
 
-            if (m_descriptor_set_layout) {
-                vkDestroyDescriptorSetLayout(m_renderer.vk.device, m_descriptor_set_layout, nullptr);
-                m_descriptor_set_layout = VK_NULL_HANDLE;
+            if (m_frame_set_layout) {
+                vkDestroyDescriptorSetLayout(m_renderer.vk.device, m_frame_set_layout, nullptr);
+                m_frame_set_layout = VK_NULL_HANDLE;
+            }
+
+            if (m_material_set_layout) {
+                vkDestroyDescriptorSetLayout(m_renderer.vk.device, m_material_set_layout, nullptr);
+                m_material_set_layout = VK_NULL_HANDLE;
             }
 
             if (auto res = make_vk_descriptor_pool_and_sets(); !res)
                 return res;
 
-            if (!rebuild)
+            if (!rebuild_pipeline)
                 return {};
 
+            // builds that are still running were handed the render pass and layout about to be destroyed
+            wait_for_builds();
+
             m_renderer.m_logger->trace("creating a vulkan pipeline layout");
 
             if (m_pipeline_layout)
@@ -63,47 +99,11 @@ namespace arbor {
             if (m_render_pass)
                 vkDestroyRenderPass(m_renderer.vk.device, m_render_pass, nullptr);
 
-            if (m_pipeline)
-                vkDestroyPipeline(m_renderer.vk.device, m_pipeline, nullptr);
-
-            m_dynamic_state.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
-            m_dynamic_state.dynamicStateCount = m_dynamic_states.size();
-            m_dynamic_state.pDynamicStates = m_dynamic_states.data();
-
-            auto&& [vertex_binding, vertex_attributes] = assets::vertex_3d::make_vk_binding();
-
-            m_vertex_input_state.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-            m_vertex_input_state.vertexBindingDescriptionCount = 1;
-            m_vertex_input_state.pVertexBindingDescriptions = &vertex_binding;
-            m_vertex_input_state.vertexAttributeDescriptionCount = vertex_attributes.size();
-            m_vertex_input_state.pVertexAttributeDescriptions = vertex_attributes.data();
-
-            m_input_assembly_state.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-            m_input_assembly_state.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
-
-            m_rasterizer_state.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
-            m_rasterizer_state.polygonMode = VK_POLYGON_MODE_FILL;
-            m_rasterizer_state.lineWidth = 1.0f;
-            m_rasterizer_state.cullMode = VK_CULL_MODE_BACK_BIT;
-            m_rasterizer_state.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
-
-            m_multisampler_state.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-            m_multisampler_state.rasterizationSamples = m_renderer.vk.config.sample_count;
-            m_multisampler_state.minSampleShading = 1.0f;
-
-            if (m_renderer.vk.physical_device.features.sampleRateShading)
-                m_multisampler_state.sampleShadingEnable = VK_TRUE;
-
-            m_color_blend_attachment.colorWriteMask =
-                VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-
-            m_color_blend_state.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
-            m_color_blend_state.attachmentCount = 1;
-            m_color_blend_state.pAttachments = &m_color_blend_attachment;
+            std::array<VkDescriptorSetLayout, 2> set_layouts = {m_frame_set_layout, m_material_set_layout};
 
             m_pipeline_layout_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-            m_pipeline_layout_create_info.setLayoutCount = 1;
-            m_pipeline_layout_create_info.pSetLayouts = &m_descriptor_set_layout;
+            m_pipeline_layout_create_info.setLayoutCount = set_layouts.size();
+            m_pipeline_layout_create_info.pSetLayouts = set_layouts.data();
 
             if (auto res =
                     vkCreatePipelineLayout(m_renderer.vk.device, &m_pipeline_layout_create_info, nullptr, &m_pipeline_layout);
@@ -159,7 +159,8 @@ namespace arbor {
             depth_attachment_description.format = m_renderer.vk.swapchain.depth_format;
             depth_attachment_description.samples = m_renderer.vk.config.sample_count;
             depth_attachment_description.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-            depth_attachment_description.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+            depth_attachment_description.storeOp =
+                m_renderer.vk.config.occlusion_culling ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
             depth_attachment_description.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
             depth_attachment_description.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
             depth_attachment_description.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
@@ -189,82 +190,233 @@ namespace arbor {
                 res != VK_SUCCESS)
                 return std::unexpected(fmt::format("failed to create a vulkan render pass: {}", string_VkResult(res)));
 
-            VkGraphicsPipelineCreateInfo pipeline_create_info{};
-            VkPipelineDepthStencilStateCreateInfo stencil_state_create_info{};
-
-            m_renderer.m_logger->trace("creating a vulkan pipeline with {} stages", m_pipeline_stages.size());
-
             m_viewport.maxDepth = 1.0f;
             m_viewport.width = m_renderer.vk.swapchain.extent.width;
             m_viewport.height = m_renderer.vk.swapchain.extent.height;
 
             m_scissor.extent = m_renderer.vk.swapchain.extent;
 
-            m_viewport_state.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-            m_viewport_state.viewportCount = 1;
-            m_viewport_state.pViewports = &m_viewport;
-            m_viewport_state.scissorCount = 1;
-            m_viewport_state.pScissors = &m_scissor;
+            m_target = {
+                .color_format = m_renderer.vk.swapchain.format.format,
+                .depth_format = m_renderer.vk.swapchain.depth_format,
+                .samples = m_renderer.vk.config.sample_count,
+            };
 
-            stencil_state_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
-            stencil_state_create_info.depthTestEnable = VK_TRUE;
-            stencil_state_create_info.depthWriteEnable = VK_TRUE;
-            stencil_state_create_info.depthCompareOp = VK_COMPARE_OP_LESS;
+            if (auto res = poll_builds(); !res)
+                return res;
 
-            pipeline_create_info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-            pipeline_create_info.stageCount = m_pipeline_stages.size();
-            pipeline_create_info.pStages = m_pipeline_stages.data();
-            pipeline_create_info.pVertexInputState = &m_vertex_input_state;
-            pipeline_create_info.pInputAssemblyState = &m_input_assembly_state;
-            pipeline_create_info.pViewportState = &m_viewport_state;
-            pipeline_create_info.pRasterizationState = &m_rasterizer_state;
-            pipeline_create_info.pMultisampleState = &m_multisampler_state;
-            pipeline_create_info.pColorBlendState = &m_color_blend_state;
-            pipeline_create_info.pDynamicState = &m_dynamic_state;
-            pipeline_create_info.pDepthStencilState = &stencil_state_create_info;
+            // a resize leaves the targets as they are, pipelines in use stay compatible with the new render pass
+            for (auto variant = 0u; variant < m_variants.size(); variant++)
+                if (!ready(variant))
+                    rebuild(variant);
 
-            pipeline_create_info.subpass = 0;
-            pipeline_create_info.renderPass = m_render_pass;
-            pipeline_create_info.layout = m_pipeline_layout;
+            return {};
+        }
 
-            pipeline_create_info.basePipelineHandle = m_pipeline;
+        uint32_t renderer::pipeline::variant_index(const pipeline::shader_sources& sources) {
+            auto key = hash_bytes(nullptr, 0);
+            for (const auto& [type, source] : sources)
+                key = hash_combine(hash_combine(key, type), hash_string(source.string()));
 
-            if (auto res = vkCreateGraphicsPipelines(m_renderer.vk.device, VK_NULL_HANDLE, 1, &pipeline_create_info, nullptr,
-                                                     &m_pipeline);
-                res != VK_SUCCESS)
-                return std::unexpected(fmt::format("failed to create a vulkan pipeline: {}", string_VkResult(res)));
+            // probe past hash collisions like the asset library does
+            while (m_variant_indices.contains(key) && m_variants[m_variant_indices.at(key)].sources != sources)
+                key++;
 
-            return {};
+            if (auto it = m_variant_indices.find(key); it != m_variant_indices.end())
+                return it->second;
+
+            const auto index = static_cast<uint32_t>(m_variants.size());
+            m_variants.push_back({.sources = sources});
+            m_variant_indices[key] = index;
+
+            if (m_renderer.vk.config.shader_hot_reload)
+                for (const auto& [type, source] : sources)
+                    m_renderer.m_shader_watcher.watch(source);
+
+            if (m_render_pass)
+                rebuild(index);
+
+            return index;
         }
 
-        std::expected<void, std::string> renderer::pipeline::bind_shader(const std::filesystem::path& glsl_source,
-                                                                         shader::etype type) {
-            if (m_shaders.contains(type))
-                m_shaders.erase(type);
+        void renderer::pipeline::rebuild(uint32_t variant) {
+            auto build = std::make_shared<pipeline::build>();
 
-            m_shaders[type] = {glsl_source, type, m_renderer.vk.device};
+            build->variant = variant;
+            build->generation = ++m_generation;
+            build->target = m_target;
+            build->device = m_renderer.vk.device;
+            build->pipeline_cache = m_renderer.vk.pipeline_cache;
+            build->render_pass = m_render_pass;
+            build->layout = m_pipeline_layout;
+            build->sample_shading = m_renderer.vk.physical_device.features.sampleRateShading;
+            build->shader_cache_path = m_renderer.vk.shader_cache_path;
 
-            m_renderer.m_logger->trace("binding glsl shader: {}", m_shaders[type].source().string().c_str());
-            if (auto res = m_shaders[type].compile(); !res)
-                return res;
+            build->shaders.reserve(m_variants[variant].sources.size());
+            for (const auto& [type, source] : m_variants[variant].sources)
+                build->shaders.emplace_back(source, type, m_renderer.vk.device);
+
+            m_renderer.m_logger->trace("building vulkan pipeline variant {} ({} stages)", variant, build->shaders.size());
+
+            // a build takes seconds, the frames keep going with the variant's previous pipeline in the meantime
+            build->job = m_renderer.m_engine.jobs().submit_background([build = build.get()] { compile_and_link(*build); });
+            m_builds.push_back(std::move(build));
+        }
+
+        std::expected<void, std::string> renderer::pipeline::poll_builds() {
+            std::string error;
+
+            for (auto it = m_builds.begin(); it != m_builds.end();) {
+                auto& build = **it;
+                if (!build.job.done()) {
+                    it++;
+                    continue;
+                }
+
+                auto& variant = m_variants[build.variant];
+
+                if (!build.pipeline) {
+                    m_renderer.m_logger->error("failed to build vulkan pipeline variant {}: {}", build.variant, build.error);
 
-            VkPipelineShaderStageCreateInfo* create_info;
+                    const auto pending = std::ranges::any_of(m_builds, [&](const auto& other) {
+                        return other->variant == build.variant && other->generation > build.generation;
+                    });
 
-            if (auto it = std::ranges::find_if(m_pipeline_stages,
-                                               [&](const auto& stage) { return stage.stage == m_shaders[type].stage(); });
-                it == m_pipeline_stages.end()) {
-                m_pipeline_stages.push_back({});
-                create_info = &m_pipeline_stages.back();
-            } else {
-                create_info = &*it;
+                    if (!variant.handle && !pending)
+                        error = std::move(build.error);
+                } else if (build.generation > variant.generation) {
+                    if (auto old = variant.handle)
+                        m_renderer.retire([device = m_renderer.vk.device, old] { vkDestroyPipeline(device, old, nullptr); });
+
+                    m_renderer.m_logger->debug("swapped in vulkan pipeline variant {}", build.variant);
+
+                    variant.handle = build.pipeline;
+                    variant.target = build.target;
+                    variant.generation = build.generation;
+                } else {
+                    // a newer build finished first, this one was never bound
+                    vkDestroyPipeline(m_renderer.vk.device, build.pipeline, nullptr);
+                }
+
+                it = m_builds.erase(it);
             }
 
-            create_info->sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-            create_info->stage = m_shaders[type].stage();
-            create_info->module = m_shaders[type].shader_module();
-            create_info->pName = "main";
+            if (!error.empty())
+                return std::unexpected(error);
 
             return {};
         }
+
+        void renderer::pipeline::wait_for_builds() {
+            for (const auto& build : m_builds)
+                m_renderer.m_engine.jobs().wait(build->job);
+        }
+
+        void renderer::pipeline::compile_and_link(pipeline::build& build) {
+            std::vector<VkPipelineShaderStageCreateInfo> stages;
+
+            for (auto& shader : build.shaders) {
+                if (auto res = shader.compile(build.shader_cache_path); !res) {
+                    build.error = fmt::format("failed to compile {}: {}", shader.source().string(), res.error());
+                    return;
+                }
+
+                stages.push_back({
+                    .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+                    .stage = shader.stage(),
+                    .module = shader.shader_module(),
+                    .pName = "main",
+                });
+            }
+
+            std::array<VkDynamicState, 2> dynamic_states = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
+
+            VkPipelineDynamicStateCreateInfo dynamic_state{};
+            dynamic_state.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+            dynamic_state.dynamicStateCount = dynamic_states.size();
+            dynamic_state.pDynamicStates = dynamic_states.data();
+
+            auto&& [vertex_binding, vertex_attributes] = assets::vertex_3d::make_vk_binding();
+
+            VkPipelineVertexInputStateCreateInfo vertex_input_state{};
+            vertex_input_state.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+            vertex_input_state.vertexBindingDescriptionCount = 1;
+            vertex_input_state.pVertexBindingDescriptions = &vertex_binding;
+            vertex_input_state.vertexAttributeDescriptionCount = vertex_attributes.size();
+            vertex_input_state.pVertexAttributeDescriptions = vertex_attributes.data();
+
+            VkPipelineInputAssemblyStateCreateInfo input_assembly_state{};
+            input_assembly_state.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+            input_assembly_state.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+
+            VkPipelineRasterizationStateCreateInfo rasterizer_state{};
+            rasterizer_state.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+            rasterizer_state.polygonMode = VK_POLYGON_MODE_FILL;
+            rasterizer_state.lineWidth = 1.0f;
+            rasterizer_state.cullMode = VK_CULL_MODE_BACK_BIT;
+            rasterizer_state.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+
+            VkPipelineMultisampleStateCreateInfo multisampler_state{};
+            multisampler_state.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+            multisampler_state.rasterizationSamples = build.target.samples;
+            multisampler_state.minSampleShading = 1.0f;
+
+            if (build.sample_shading)
+                multisampler_state.sampleShadingEnable = VK_TRUE;
+
+            VkPipelineColorBlendAttachmentState color_blend_attachment{};
+            color_blend_attachment.colorWriteMask =
+                VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+
+            VkPipelineColorBlendStateCreateInfo color_blend_state{};
+            color_blend_state.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+            color_blend_state.attachmentCount = 1;
+            color_blend_state.pAttachments = &color_blend_attachment;
+
+            // both are dynamic, only their counts are baked into the pipeline
+            VkPipelineViewportStateCreateInfo viewport_state{};
+            viewport_state.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+            viewport_state.viewportCount = 1;
+            viewport_state.scissorCount = 1;
+
+            VkPipelineDepthStencilStateCreateInfo stencil_state_create_info{};
+            stencil_state_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+            stencil_state_create_info.depthTestEnable = VK_TRUE;
+            stencil_state_create_info.depthWriteEnable = VK_TRUE;
+            stencil_state_create_info.depthCompareOp = VK_COMPARE_OP_LESS;
+
+            VkGraphicsPipelineCreateInfo pipeline_create_info{};
+            pipeline_create_info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+            pipeline_create_info.stageCount = stages.size();
+            pipeline_create_info.pStages = stages.data();
+            pipeline_create_info.pVertexInputState = &vertex_input_state;
+            pipeline_create_info.pInputAssemblyState = &input_assembly_state;
+            pipeline_create_info.pViewportState = &viewport_state;
+            pipeline_create_info.pRasterizationState = &rasterizer_state;
+            pipeline_create_info.pMultisampleState = &multisampler_state;
+            pipeline_create_info.pColorBlendState = &color_blend_state;
+            pipeline_create_info.pDynamicState = &dynamic_state;
+            pipeline_create_info.pDepthStencilState = &stencil_state_create_info;
+
+            pipeline_create_info.subpass = 0;
+            pipeline_create_info.renderPass = build.render_pass;
+            pipeline_create_info.layout = build.layout;
+
+            // pipeline caches are internally synchronized, concurrent builds can share one
+            if (auto res = vkCreateGraphicsPipelines(build.device, build.pipeline_cache, 1, &pipeline_create_info, nullptr,
+                                                     &build.pipeline);
+                res != VK_SUCCESS) {
+                build.pipeline = VK_NULL_HANDLE;
+                build.error = fmt::format("failed to create a vulkan pipeline: {}", string_VkResult(res));
+            }
+
+            // the modules aren't needed once the pipeline exists
+            build.shaders.clear();
+        }
+
+        bool renderer::pipeline::uses_shader(uint32_t variant, const std::filesystem::path& glsl_source) const {
+            return std::ranges::any_of(m_variants[variant].sources,
+                                       [&](const auto& source) { return source.second == glsl_source; });
+        }
     } // namespace engine
 } // namespace arbor
\ No newline at end of file
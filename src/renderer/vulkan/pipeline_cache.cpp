@@ -0,0 +1,123 @@
+#include "arbor/components/renderer.hpp"
+
+#include "arbor/hash.hpp"
+#include "vulkan/vk_enum_string_helper.h"
+
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <vulkan/vulkan_core.h>
+
+namespace arbor {
+    namespace engine {
+        namespace {
+            // the driver validates its own blob too, but a foreign or truncated one is better not handed to it at all
+            struct pipeline_cache_header {
+                uint32_t magic;
+                uint32_t version;
+                uint32_t vendor_id;
+                uint32_t device_id;
+                uint32_t driver_version;
+                uint8_t pipeline_cache_uuid[VK_UUID_SIZE];
+                uint64_t data_size;
+                uint64_t data_hash;
+            };
+
+            constexpr uint32_t pipeline_cache_magic = 0x43505241; // "ARPC"
+            constexpr uint32_t pipeline_cache_version = 1;
+
+            pipeline_cache_header make_pipeline_cache_header(const VkPhysicalDeviceProperties& properties) {
+                pipeline_cache_header header{};
+                header.magic = pipeline_cache_magic;
+                header.version = pipeline_cache_version;
+                header.vendor_id = properties.vendorID;
+                header.device_id = properties.deviceID;
+                header.driver_version = properties.driverVersion;
+                std::memcpy(header.pipeline_cache_uuid, properties.pipelineCacheUUID, VK_UUID_SIZE);
+
+                return header;
+            }
+        } // namespace
+
+        std::expected<void, std::string> renderer::make_vk_pipeline_cache() {
+            const auto expected = make_pipeline_cache_header(vk.physical_device.properties);
+            std::vector<char> data;
+
+            if (std::ifstream stream(vk.pipeline_cache_path, std::ios::binary); stream) {
+                std::vector<char> file = {std::istreambuf_iterator(stream), std::istreambuf_iterator<char>()};
+
+                pipeline_cache_header header{};
+                if (file.size() >= sizeof(header))
+                    std::memcpy(&header, file.data(), sizeof(header));
+
+                const auto payload = file.size() - std::min(file.size(), sizeof(header));
+
+                if (header.magic != expected.magic || header.version != expected.version ||
+                    header.vendor_id != expected.vendor_id || header.device_id != expected.device_id ||
+                    header.driver_version != expected.driver_version ||
+                    std::memcmp(header.pipeline_cache_uuid, expected.pipeline_cache_uuid, VK_UUID_SIZE) ||
+                    header.data_size != payload)
+                    m_logger->debug("discarding the pipeline cache at '{}', it was made for a different device or driver",
+                                    vk.pipeline_cache_path.string());
+                else if (header.data_hash != hash_bytes(file.data() + sizeof(header), payload))
+                    m_logger->warn("discarding the pipeline cache at '{}', it is corrupted", vk.pipeline_cache_path.string());
+                else
+                    data.assign(file.begin() + sizeof(header), file.end());
+            }
+
+            VkPipelineCacheCreateInfo create_info{};
+            create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+            create_info.initialDataSize = data.size();
+            create_info.pInitialData = data.empty() ? nullptr : data.data();
+
+            m_logger->debug("creating a vulkan pipeline cache ({} bytes loaded)", data.size());
+
+            if (auto res = vkCreatePipelineCache(vk.device, &create_info, nullptr, &vk.pipeline_cache); res != VK_SUCCESS)
+                return std::unexpected(fmt::format("failed to create a pipeline cache: {}", string_VkResult(res)));
+
+            return {};
+        }
+
+        std::expected<void, std::string> renderer::save_vk_pipeline_cache() {
+            if (!vk.pipeline_cache)
+                return {};
+
+            uint64_t size = 0;
+            if (auto res = vkGetPipelineCacheData(vk.device, vk.pipeline_cache, &size, nullptr); res != VK_SUCCESS)
+                return std::unexpected(fmt::format("failed to query the pipeline cache size: {}", string_VkResult(res)));
+
+            std::vector<char> data(size);
+            if (auto res = vkGetPipelineCacheData(vk.device, vk.pipeline_cache, &size, data.data()); res != VK_SUCCESS)
+                return std::unexpected(fmt::format("failed to read the pipeline cache: {}", string_VkResult(res)));
+
+            auto header = make_pipeline_cache_header(vk.physical_device.properties);
+            header.data_size = size;
+            header.data_hash = hash_bytes(data.data(), size);
+
+            // written next to the old cache and swapped in, so a crash mid-write never leaves a torn file behind
+            auto temporary = vk.pipeline_cache_path;
+            temporary += ".tmp";
+
+            {
+                std::ofstream stream(temporary, std::ios::binary | std::ios::trunc);
+                if (!stream)
+                    return std::unexpected(fmt::format("failed to open '{}' for writing", temporary.string()));
+
+                stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+                stream.write(data.data(), size);
+
+                if (!stream)
+                    return std::unexpected(fmt::format("failed to write the pipeline cache to '{}'", temporary.string()));
+            }
+
+            std::error_code error;
+            std::filesystem::rename(temporary, vk.pipeline_cache_path, error);
+            if (error)
+                return std::unexpected(fmt::format("failed to replace the pipeline cache: {}", error.message()));
+
+            m_logger->debug("saved {} bytes of pipeline cache to '{}'", size, vk.pipeline_cache_path.string());
+
+            return {};
+        }
+    } // namespace engine
+} // namespace arbor
\ No newline at end of file
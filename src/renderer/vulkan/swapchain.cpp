@@ -101,8 +101,13 @@ namespace arbor {
             vk.swapchain.framebuffers.resize(vk_n);
             vkGetSwapchainImagesKHR(vk.device, vk.swapchain.handle, &vk_n, vk.swapchain.images.data());
 
+            // the culling stage builds its depth pyramid from the previous frame's depth buffer
+            const auto depth_usage = vk.config.occlusion_culling
+                                         ? VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT
+                                         : VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+
             if (auto res = make_image(vk.swapchain.extent.width, vk.swapchain.extent.height, vk.swapchain.depth_format,
-                                      VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, VK_IMAGE_ASPECT_DEPTH_BIT,
+                                      depth_usage, VK_IMAGE_ASPECT_DEPTH_BIT,
                                       VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, vk.config.sample_count);
                 !res) {
                 return std::unexpected(res.error());
@@ -116,6 +121,9 @@ namespace arbor {
             transition_image_layout(vk.swapchain.depth_image, VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT,
                                     VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL);
 
+            if (auto res = m_culling.make_pyramid(); !res)
+                return res;
+
             if (auto res = make_image(vk.swapchain.extent.width, vk.swapchain.extent.height, vk.swapchain.format.format,
                                       VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
                                       VK_IMAGE_ASPECT_COLOR_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, vk.config.sample_count);
@@ -218,10 +226,7 @@ namespace arbor {
                 vk.swapchain.depth_image = VK_NULL_HANDLE;
             }
 
-            if (vk.swapchain.depth_buffer && vk.device) {
-                vkFreeMemory(vk.device, vk.swapchain.depth_buffer, nullptr);
-                vk.swapchain.depth_buffer = VK_NULL_HANDLE;
-            }
+            vk.allocator.free(vk.swapchain.depth_buffer);
 
             if (vk.swapchain.msaa_image_view && vk.device) {
                 vkDestroyImageView(vk.device, vk.swapchain.msaa_image_view, nullptr);
@@ -233,14 +238,14 @@ namespace arbor {
                 vk.swapchain.msaa_image = VK_NULL_HANDLE;
             }
 
-            if (vk.swapchain.msaa_image_buffer && vk.device) {
-                vkFreeMemory(vk.device, vk.swapchain.msaa_image_buffer, nullptr);
-                vk.swapchain.msaa_image_buffer = VK_NULL_HANDLE;
-            }
+            vk.allocator.free(vk.swapchain.msaa_image_buffer);
 
             if (vk.swapchain.handle && vk.device)
                 vkDestroySwapchainKHR(vk.device, vk.swapchain.handle, nullptr);
 
+            // the sample count may have changed, the depth image and render pass depend on whether occlusion is on
+            update_occlusion_culling();
+
             if (auto res = make_vk_swapchain_and_pipeline(); !res)
                 return res;
 
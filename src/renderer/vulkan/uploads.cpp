@@ -0,0 +1,423 @@
+#include "arbor/components/renderer.hpp"
+
+#include "vulkan/vk_enum_string_helper.h"
+#include <algorithm>
+#include <cstring>
+#include <vulkan/vulkan_core.h>
+
+namespace arbor {
+    namespace engine {
+        renderer::upload_queue::~upload_queue() {
+            destroy();
+        }
+
+        std::expected<void, std::string> renderer::upload_queue::init() {
+            auto& vk = m_renderer.vk;
+            const auto& families = vk.physical_device.queue_family_indices;
+
+            m_queue = vk.transfer_queue;
+            m_families = {families.graphics_family, families.transfer_family};
+            m_n_families = families.graphics_family == families.transfer_family ? 1 : 2;
+
+            m_renderer.m_logger->debug("uploading on queue family {} ({})", families.transfer_family,
+                                       m_n_families > 1 ? "dedicated" : "shared with graphics");
+
+            VkCommandPoolCreateInfo pool_create_info{};
+            pool_create_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+            pool_create_info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+            pool_create_info.queueFamilyIndex = families.transfer_family;
+
+            if (auto res = vkCreateCommandPool(vk.device, &pool_create_info, nullptr, &m_command_pool); res != VK_SUCCESS)
+                return std::unexpected(fmt::format("failed to create an upload command pool: {}", string_VkResult(res)));
+
+            VkSemaphoreTypeCreateInfo type_create_info{};
+            type_create_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+            type_create_info.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+            type_create_info.initialValue = 0;
+
+            VkSemaphoreCreateInfo semaphore_create_info{};
+            semaphore_create_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+            semaphore_create_info.pNext = &type_create_info;
+
+            if (auto res = vkCreateSemaphore(vk.device, &semaphore_create_info, nullptr, &m_timeline); res != VK_SUCCESS)
+                return std::unexpected(fmt::format("failed to create an upload timeline semaphore: {}", string_VkResult(res)));
+
+            m_renderer.m_logger->trace("allocating a staging ring of {} bytes", vk.config.staging_ring_size);
+
+            if (auto res = m_ring.make(vk.config.staging_ring_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                                       VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, vk.allocator);
+                !res)
+                return res;
+
+            m_submitted = 0;
+            m_awaited = 0;
+            m_ring_head = 0;
+            m_ring_tail = 0;
+
+            return {};
+        }
+
+        void renderer::upload_queue::destroy() {
+            auto device = m_renderer.vk.device;
+            if (!device)
+                return;
+
+            if (m_timeline)
+                wait(m_submitted);
+
+            m_recording = {};
+            m_in_flight.clear();
+            m_free_command_buffers.clear();
+            m_mip_chains.clear();
+            m_ring.free();
+
+            for (auto& [value, destroy] : m_releases)
+                destroy();
+            m_releases.clear();
+
+            if (m_command_pool) {
+                vkDestroyCommandPool(device, m_command_pool, nullptr);
+                m_command_pool = VK_NULL_HANDLE;
+            }
+
+            if (m_timeline) {
+                vkDestroySemaphore(device, m_timeline, nullptr);
+                m_timeline = VK_NULL_HANDLE;
+            }
+        }
+
+        std::expected<VkCommandBuffer, std::string> renderer::upload_queue::recording_command_buffer() {
+            if (m_recording.command_buffer)
+                return m_recording.command_buffer;
+
+            if (!m_free_command_buffers.empty()) {
+                m_recording.command_buffer = m_free_command_buffers.back();
+                m_free_command_buffers.pop_back();
+            } else {
+                VkCommandBufferAllocateInfo allocate_info{};
+                allocate_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+                allocate_info.commandPool = m_command_pool;
+                allocate_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+                allocate_info.commandBufferCount = 1;
+
+                if (auto res = vkAllocateCommandBuffers(m_renderer.vk.device, &allocate_info, &m_recording.command_buffer);
+                    res != VK_SUCCESS)
+                    return std::unexpected(
+                        fmt::format("failed to allocate an upload command buffer: {}", string_VkResult(res)));
+            }
+
+            VkCommandBufferBeginInfo begin_info{};
+            begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+            begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+            if (auto res = vkBeginCommandBuffer(m_recording.command_buffer, &begin_info); res != VK_SUCCESS)
+                return std::unexpected(fmt::format("failed to begin an upload command buffer: {}", string_VkResult(res)));
+
+            // buffers grown in an earlier batch are copied from in later ones, submission order alone doesn't make
+            // the earlier writes visible
+            VkMemoryBarrier barrier{};
+            barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+            barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+            vkCmdPipelineBarrier(m_recording.command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+                                 1, &barrier, 0, nullptr, 0, nullptr);
+
+            return m_recording.command_buffer;
+        }
+
+        void renderer::upload_queue::wait(uint64_t value) {
+            if (!value)
+                return;
+
+            VkSemaphoreWaitInfo wait_info{};
+            wait_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+            wait_info.semaphoreCount = 1;
+            wait_info.pSemaphores = &m_timeline;
+            wait_info.pValues = &value;
+
+            vkWaitSemaphores(m_renderer.vk.device, &wait_info, uint64_t(-1));
+        }
+
+        std::expected<uint64_t, std::string> renderer::upload_queue::allocate_staging(uint64_t size) {
+            const auto capacity = m_ring.size();
+
+            while (true) {
+                // nothing staged is still in use, start over at the beginning of the ring
+                if (m_ring_head == m_ring_tail)
+                    m_ring_head = m_ring_tail = (m_ring_head + capacity - 1) / capacity * capacity;
+
+                // regions never wrap around the end of the ring, what's left of it is skipped instead
+                auto start = (m_ring_head + staging_alignment - 1) / staging_alignment * staging_alignment;
+                if (start % capacity + size > capacity)
+                    start = (start / capacity + 1) * capacity;
+
+                if (start + size - m_ring_tail <= capacity) {
+                    m_ring_head = start + size;
+                    return start % capacity;
+                }
+
+                // the copies staged so far have to be submitted before their regions can ever be freed
+                if (m_in_flight.empty())
+                    if (auto res = flush(); !res)
+                        return std::unexpected(res.error());
+
+                if (m_in_flight.empty())
+                    return std::unexpected("failed to stage an upload: the staging ring is exhausted");
+
+                m_renderer.m_logger->trace("the staging ring is full, waiting on upload batch {}", m_in_flight.front().value);
+
+                wait(m_in_flight.front().value);
+                collect();
+            }
+        }
+
+        std::expected<std::pair<VkBuffer, uint64_t>, std::string> renderer::upload_queue::stage(const void* bytes,
+                                                                                                 uint64_t size) {
+            if (size > m_ring.size()) {
+                auto staging = std::make_unique<renderer::device_buffer>();
+                if (auto res = staging->make(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                                             VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                             m_renderer.vk.allocator);
+                    !res)
+                    return std::unexpected(res.error());
+
+                if (auto res = staging->write_data(bytes, size); !res)
+                    return std::unexpected(res.error());
+
+                const auto buffer = *staging->buffer();
+                m_recording.oversized.push_back(std::move(staging));
+
+                return {{buffer, 0}};
+            }
+
+            auto offset = allocate_staging(size);
+            if (!offset)
+                return std::unexpected(offset.error());
+
+            std::memcpy(static_cast<uint8_t*>(m_ring.mapped()) + *offset, bytes, size);
+
+            return {{*m_ring.buffer(), *offset}};
+        }
+
+        std::expected<void, std::string> renderer::upload_queue::copy_to_buffer(const void* bytes, uint64_t size,
+                                                                                VkBuffer destination, uint64_t offset) {
+            // staged first, making room in the ring may submit the batch being recorded
+            auto staging = stage(bytes, size);
+            if (!staging)
+                return std::unexpected(staging.error());
+
+            auto command_buffer = recording_command_buffer();
+            if (!command_buffer)
+                return std::unexpected(command_buffer.error());
+
+            const auto& [source, source_offset] = *staging;
+            VkBufferCopy region{.srcOffset = source_offset, .dstOffset = offset, .size = size};
+            vkCmdCopyBuffer(*command_buffer, source, destination, 1, &region);
+            m_recording.n_copies++;
+
+            return {};
+        }
+
+        std::expected<void, std::string> renderer::upload_queue::copy_buffer(VkBuffer source, VkBuffer destination,
+                                                                             const VkBufferCopy& region) {
+            auto command_buffer = recording_command_buffer();
+            if (!command_buffer)
+                return std::unexpected(command_buffer.error());
+
+            // the source may have been written by a copy earlier in the batch
+            VkMemoryBarrier barrier{};
+            barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+            barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+            vkCmdPipelineBarrier(*command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier,
+                                 0, nullptr, 0, nullptr);
+
+            vkCmdCopyBuffer(*command_buffer, source, destination, 1, &region);
+            m_recording.n_copies++;
+
+            return {};
+        }
+
+        std::expected<void, std::string> renderer::upload_queue::copy_to_image(const void* bytes, uint64_t size, VkImage image,
+                                                                               std::span<const VkBufferImageCopy> regions,
+                                                                               uint32_t mip_levels) {
+            auto staging = stage(bytes, size);
+            if (!staging)
+                return std::unexpected(staging.error());
+
+            auto command_buffer = recording_command_buffer();
+            if (!command_buffer)
+                return std::unexpected(command_buffer.error());
+
+            VkImageMemoryBarrier barrier{};
+            barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+            barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+            barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.image = image;
+            barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            barrier.subresourceRange.levelCount = mip_levels;
+            barrier.subresourceRange.layerCount = 1;
+            barrier.srcAccessMask = 0;
+            barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+
+            vkCmdPipelineBarrier(*command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0,
+                                 nullptr, 0, nullptr, 1, &barrier);
+
+            std::vector<VkBufferImageCopy> staged(regions.begin(), regions.end());
+            for (auto& region : staged)
+                region.bufferOffset += staging->second;
+
+            vkCmdCopyBufferToImage(*command_buffer, staging->first, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, staged.size(),
+                                   staged.data());
+
+            m_recording.n_copies++;
+
+            // every level stays a transfer destination until the chain is blitted
+            if (mip_levels > regions.size()) {
+                m_recording.mip_chains.push_back({
+                    .image = image,
+                    .width = regions.front().imageExtent.width,
+                    .height = regions.front().imageExtent.height,
+                    .levels = mip_levels,
+                });
+                return {};
+            }
+
+            // transfer queues can't name the fragment stage, the frames' wait on the timeline makes the writes visible
+            barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+            barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+            barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            barrier.dstAccessMask = 0;
+
+            vkCmdPipelineBarrier(*command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0,
+                                 nullptr, 0, nullptr, 1, &barrier);
+
+            return {};
+        }
+
+        void renderer::upload_queue::record_mip_chains(VkCommandBuffer command_buffer) {
+            VkImageMemoryBarrier barrier{};
+            barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            barrier.subresourceRange.levelCount = 1;
+            barrier.subresourceRange.layerCount = 1;
+
+            // every level is blitted from the one above it, it's read-only for the shaders once the next one is written
+            const auto transition = [&](uint32_t level, VkImageLayout old_layout, VkImageLayout new_layout,
+                                        VkAccessFlags src_access, VkAccessFlags dst_access, VkPipelineStageFlags dst_stage) {
+                barrier.subresourceRange.baseMipLevel = level;
+                barrier.oldLayout = old_layout;
+                barrier.newLayout = new_layout;
+                barrier.srcAccessMask = src_access;
+                barrier.dstAccessMask = dst_access;
+
+                vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, dst_stage, 0, 0, nullptr, 0, nullptr, 1,
+                                     &barrier);
+            };
+
+            for (const auto& chain : m_mip_chains) {
+                barrier.image = chain.image;
+
+                auto width = static_cast<int32_t>(chain.width);
+                auto height = static_cast<int32_t>(chain.height);
+
+                for (auto level = 1u; level < chain.levels; level++) {
+                    transition(level - 1, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                               VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+                    VkImageBlit blit{};
+                    blit.srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level - 1, 0, 1};
+                    blit.srcOffsets[1] = {width, height, 1};
+
+                    width = std::max(width / 2, 1);
+                    height = std::max(height / 2, 1);
+
+                    blit.dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level, 0, 1};
+                    blit.dstOffsets[1] = {width, height, 1};
+
+                    vkCmdBlitImage(command_buffer, chain.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, chain.image,
+                                   VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, VK_FILTER_LINEAR);
+
+                    transition(level - 1, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                               VK_ACCESS_TRANSFER_READ_BIT, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+                }
+
+                transition(chain.levels - 1, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                           VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+            }
+
+            m_mip_chains.clear();
+        }
+
+        std::expected<void, std::string> renderer::upload_queue::flush() {
+            if (!m_recording.command_buffer)
+                return {};
+
+            if (auto res = vkEndCommandBuffer(m_recording.command_buffer); res != VK_SUCCESS)
+                return std::unexpected(fmt::format("failed to record an upload command buffer: {}", string_VkResult(res)));
+
+            m_recording.value = m_submitted + 1;
+            m_recording.ring_end = m_ring_head;
+
+            VkTimelineSemaphoreSubmitInfo timeline_info{};
+            timeline_info.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+            timeline_info.signalSemaphoreValueCount = 1;
+            timeline_info.pSignalSemaphoreValues = &m_recording.value;
+
+            VkSubmitInfo submit_info{};
+            submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+            submit_info.pNext = &timeline_info;
+            submit_info.commandBufferCount = 1;
+            submit_info.pCommandBuffers = &m_recording.command_buffer;
+            submit_info.signalSemaphoreCount = 1;
+            submit_info.pSignalSemaphores = &m_timeline;
+
+            if (auto res = vkQueueSubmit(m_queue, 1, &submit_info, VK_NULL_HANDLE); res != VK_SUCCESS)
+                return std::unexpected(fmt::format("failed to submit uploads: {}", string_VkResult(res)));
+
+            m_renderer.m_logger->trace("submitted {} uploads as upload batch {}", m_recording.n_copies, m_recording.value);
+
+            m_submitted = m_recording.value;
+            m_mip_chains.append_range(std::move(m_recording.mip_chains));
+            m_in_flight.push_back(std::move(m_recording));
+            m_recording = {};
+
+            return {};
+        }
+
+        void renderer::upload_queue::release(std::function<void()> destroy) {
+            m_releases.emplace_back(m_submitted + (m_recording.command_buffer ? 1 : 0), std::move(destroy));
+        }
+
+        void renderer::upload_queue::collect() {
+            if (m_in_flight.empty() && m_releases.empty())
+                return;
+
+            uint64_t completed = 0;
+            vkGetSemaphoreCounterValue(m_renderer.vk.device, m_timeline, &completed);
+
+            while (!m_in_flight.empty() && m_in_flight.front().value <= completed) {
+                m_free_command_buffers.push_back(m_in_flight.front().command_buffer);
+                m_ring_tail = std::max(m_ring_tail, m_in_flight.front().ring_end);
+                m_in_flight.pop_front();
+            }
+
+            while (!m_releases.empty() && m_releases.front().first <= completed) {
+                m_releases.front().second();
+                m_releases.pop_front();
+            }
+        }
+
+        uint64_t renderer::upload_queue::take_wait_value() {
+            if (m_awaited == m_submitted)
+                return 0;
+
+            m_awaited = m_submitted;
+            return m_awaited;
+        }
+    } // namespace engine
+} // namespace arbor
\ No newline at end of file
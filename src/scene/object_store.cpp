@@ -0,0 +1,91 @@
+#include "arbor/scene/object.hpp"
+
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+
+#include "fmt/format.h"
+
+namespace arbor {
+    namespace engine {
+        engine::object_handle object_store::insert() {
+            uint32_t index;
+
+            if (!m_free_slots.empty()) {
+                index = m_free_slots.back();
+                m_free_slots.pop_back();
+            } else {
+                index = m_slots.size();
+                m_slots.emplace_back();
+            }
+
+            auto& slot = m_slots[index];
+            slot.dense = m_ids.size();
+
+            const object_handle handle(index, slot.generation);
+            m_ids.push_back(handle.packed());
+            m_transforms.emplace_back(1.0f);
+            m_callbacks.emplace_back();
+
+            return handle;
+        }
+
+        bool object_store::erase(engine::object_handle handle) {
+            if (!contains(handle))
+                return false;
+
+            // the handle goes stale right away, the dense entry stays where it is until compact()
+            auto& slot = m_slots[handle.index];
+            slot.generation++;
+
+            m_callbacks[slot.dense] = {};
+            m_pending_erase.push_back(slot.dense);
+
+            return true;
+        }
+
+        bool object_store::compact() {
+            if (m_pending_erase.empty())
+                return false;
+
+            // back to front, so the last object that's moved into an erased index is never erased itself
+            std::ranges::sort(m_pending_erase, std::greater{});
+
+            for (auto dense : m_pending_erase) {
+                auto& slot = m_slots[object_handle(m_ids[dense]).index];
+                const auto last = m_ids.size() - 1;
+
+                if (dense != last) {
+                    m_ids[dense] = m_ids[last];
+                    m_transforms[dense] = m_transforms[last];
+                    m_callbacks[dense] = std::move(m_callbacks[last]);
+                    m_slots[object_handle(m_ids[dense]).index].dense = dense;
+                }
+
+                m_ids.pop_back();
+                m_transforms.pop_back();
+                m_callbacks.pop_back();
+
+                m_free_slots.push_back(&slot - m_slots.data());
+                slot.dense = object_handle::invalid_index;
+            }
+
+            m_pending_erase.clear();
+            return true;
+        }
+
+        void object_store::clear() {
+            for (auto id : m_ids)
+                erase(id);
+
+            compact();
+        }
+
+        engine::object object_store::at(engine::object_handle handle) {
+            if (!contains(handle))
+                throw std::out_of_range(fmt::format("no object with handle {}:{}", handle.index, handle.generation));
+
+            return {*this, m_slots[handle.index].dense};
+        }
+    } // namespace engine
+} // namespace arbor
\ No newline at end of file
@@ -1,6 +1,6 @@
 #include "arbor/scene/scene.hpp"
 
-#include <random>
+#include <utility>
 
 namespace arbor {
     namespace scene {
@@ -8,39 +8,64 @@ namespace arbor {
                            const std::filesystem::path& fragment_shader_src)
             : m_name(name), m_vertex_shader(vertex_shader_src), m_fragment_shader(fragment_shader_src) {}
 
-        std::expected<uint64_t, std::string> instance::create_object() {
-            static std::mt19937_64 rng;
-            static std::uniform_int_distribution<uint64_t> rng_dist(0);
-            static std::random_device rng_device;
+        std::expected<engine::object_handle, std::string> instance::create_object() {
+            auto handle = m_objects.insert();
+            m_asset_library[handle] = {assets::invalid_handle, m_asset_library.add_material(assets::material::make_default())};
 
-            uint64_t id = rng_dist(rng);
-            while (m_objects.contains(id))
-                id = rng_dist(rng);
+            return handle;
+        }
 
-            m_objects[id] = {id};
-            m_asset_library[id] = {{}, assets::material::make_default()};
+        std::expected<void, std::string> instance::destroy_object(engine::object_handle handle) {
+            if (!m_objects.erase(handle))
+                return std::unexpected(fmt::format("no object with handle {}:{}", handle.index, handle.generation));
 
-            return id;
+            m_asset_library.entries().erase(handle);
+            return {};
         }
 
-        bool instance::is_object_drawable(uint64_t object_id) {
-            if (!m_asset_library.entries().contains(object_id))
+        bool instance::is_object_drawable(engine::object_handle object_id) {
+            if (!m_objects.contains(object_id) || !m_asset_library.entries().contains(object_id))
+                return false;
+
+            const auto& entry = m_asset_library.at(object_id);
+            if (!m_asset_library.meshes().contains(entry.mesh) || !m_asset_library.materials().contains(entry.material))
                 return false;
 
-            if (m_asset_library[object_id].model.vertices.empty() || m_asset_library[object_id].model.indices.empty())
+            if (m_asset_library.mesh(entry.mesh).vertices.empty() || m_asset_library.mesh(entry.mesh).indices.empty())
                 return false;
 
             return true;
         }
 
         std::expected<void, std::string> instance::commit() {
+            // destroyed objects leave the dense arrays only now, the renderer rebuilds its instance indices from this
+            // commit before it reads the transforms again
+            m_dirty |= m_objects.compact();
+
             m_drawable_objects.clear();
 
-            for (auto& [id, obj] : m_objects) {
+            for (auto id : m_objects.ids()) {
                 if (is_object_drawable(id))
                     m_drawable_objects.push_back(id);
             }
 
+            std::unordered_map<uint64_t, assets::library::entry> committed;
+            committed.reserve(m_drawable_objects.size());
+
+            for (auto id : m_drawable_objects) {
+                const auto& entry = committed.emplace(id, m_asset_library.at(id)).first->second;
+
+                if (auto it = m_committed.find(id);
+                    it == m_committed.end() || it->second.mesh != entry.mesh || it->second.material != entry.material)
+                    m_dirty = true;
+            }
+
+            // when every drawable object was committed before with the same assets, a smaller count means some are gone
+            if (committed.size() != m_committed.size())
+                m_dirty = true;
+
+            m_committed = std::move(committed);
+
             if (m_internal_callbacks.on_scene_change.has_value()) {
                 if (auto res = std::invoke(*m_internal_callbacks.on_scene_change); !res)
                     return res;
@@ -48,5 +73,29 @@ namespace arbor {
 
             return {};
         }
+
+        bool instance::take_dirty() {
+            return std::exchange(m_dirty, false);
+        }
+
+        void instance::defer(std::function<std::expected<void, std::string>(scene::instance&)> command) {
+            std::scoped_lock lock(m_deferred.mutex);
+            m_deferred.commands.push_back(std::move(command));
+        }
+
+        std::expected<void, std::string> instance::execute_deferred() {
+            std::vector<std::function<std::expected<void, std::string>(scene::instance&)>> commands;
+            {
+                std::scoped_lock lock(m_deferred.mutex);
+                commands.swap(m_deferred.commands);
+            }
+
+            // commands may queue more commands, those run next frame
+            for (auto& command : commands)
+                if (auto res = std::invoke(command, *this); !res)
+                    return res;
+
+            return {};
+        }
     } // namespace scene
 } // namespace arbor
\ No newline at end of file
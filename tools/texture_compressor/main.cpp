@@ -0,0 +1,395 @@
+#include "arbor/assets/texture.hpp"
+#include "arbor/types.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <print>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "stb_image.h"
+
+// encodes the png and jpg textures under the given files and directories (assets/ by default) into .ktx2 files next to
+// them with their whole mip chain, bc1 for opaque images and bc3 for the others. the engine loads those instead of
+// decoding the sources when the device can sample the format
+
+namespace {
+    using arbor::float32_t;
+    using arbor::assets::texture;
+    using color = std::array<float32_t, 3>;
+
+    struct image {
+        int32_t width = 0, height = 0;
+        std::vector<texture::pixel_rgba> pixels;
+
+        const texture::pixel_rgba& at(int32_t x, int32_t y) const {
+            return pixels[std::min(y, height - 1) * width + std::min(x, width - 1)];
+        }
+    };
+
+    template <typename T> void put(std::vector<uint8_t>& out, T value) {
+        const auto offset = out.size();
+        out.resize(offset + sizeof(T));
+        std::memcpy(out.data() + offset, &value, sizeof(T));
+    }
+
+    // 2x2 box filter, the last row and column are repeated for odd sizes
+    image downsample(const image& source) {
+        image out{.width = std::max(source.width / 2, 1), .height = std::max(source.height / 2, 1)};
+        out.pixels.resize(out.width * out.height);
+
+        for (auto y = 0; y < out.height; y++) {
+            for (auto x = 0; x < out.width; x++) {
+                const std::array quad = {source.at(x * 2, y * 2), source.at(x * 2 + 1, y * 2), source.at(x * 2, y * 2 + 1),
+                                         source.at(x * 2 + 1, y * 2 + 1)};
+
+                const auto average = [&](auto channel) {
+                    uint32_t sum = 2;
+                    for (const auto& pixel : quad)
+                        sum += pixel.*channel;
+                    return static_cast<uint8_t>(sum / 4);
+                };
+
+                out.pixels[y * out.width + x] = {average(&texture::pixel_rgba::r), average(&texture::pixel_rgba::g),
+                                                 average(&texture::pixel_rgba::b), average(&texture::pixel_rgba::a)};
+            }
+        }
+
+        return out;
+    }
+
+    uint16_t to_565(const color& c) {
+        const auto quantize = [](float32_t value, uint32_t max) {
+            return static_cast<uint16_t>(std::clamp(std::lround(value / 255.0f * max), 0l, static_cast<long>(max)));
+        };
+
+        return quantize(c[0], 31) << 11 | quantize(c[1], 63) << 5 | quantize(c[2], 31);
+    }
+
+    color from_565(uint16_t c) {
+        return {(c >> 11 & 31) * 255.0f / 31.0f, (c >> 5 & 63) * 255.0f / 63.0f, (c & 31) * 255.0f / 31.0f};
+    }
+
+    float32_t distance(const color& a, const color& b) {
+        return (a[0] - b[0]) * (a[0] - b[0]) + (a[1] - b[1]) * (a[1] - b[1]) + (a[2] - b[2]) * (a[2] - b[2]);
+    }
+
+    // the endpoints are the block's extremes along its principal axis, pulled in slightly since the ends of the
+    // palette are rarely hit exactly. always in four color mode, so it's the same for bc1 and the color half of bc3
+    void encode_color_block(std::span<const texture::pixel_rgba, 16> block, uint8_t* out) {
+        std::array<color, 16> colors;
+        color mean{};
+
+        for (auto i = 0; i < 16; i++) {
+            colors[i] = {static_cast<float32_t>(block[i].r), static_cast<float32_t>(block[i].g),
+                         static_cast<float32_t>(block[i].b)};
+            for (auto c = 0; c < 3; c++)
+                mean[c] += colors[i][c] / 16.0f;
+        }
+
+        std::array<std::array<float32_t, 3>, 3> covariance{};
+        for (const auto& pixel : colors)
+            for (auto row = 0; row < 3; row++)
+                for (auto column = 0; column < 3; column++)
+                    covariance[row][column] += (pixel[row] - mean[row]) * (pixel[column] - mean[column]);
+
+        // a few rounds of power iteration are plenty to find the dominant direction
+        color axis = {1.0f, 1.0f, 1.0f};
+        for (auto iteration = 0; iteration < 8; iteration++) {
+            color next{};
+            for (auto row = 0; row < 3; row++)
+                for (auto column = 0; column < 3; column++)
+                    next[row] += covariance[row][column] * axis[column];
+
+            const auto length = std::max({std::abs(next[0]), std::abs(next[1]), std::abs(next[2])});
+            if (length < 1e-6f)
+                break;
+
+            for (auto c = 0; c < 3; c++)
+                axis[c] = next[c] / length;
+        }
+
+        auto lowest = 0, highest = 0;
+        auto min_projection = INFINITY, max_projection = -INFINITY;
+        for (auto i = 0; i < 16; i++) {
+            const auto projection = (colors[i][0] - mean[0]) * axis[0] + (colors[i][1] - mean[1]) * axis[1] +
+                                    (colors[i][2] - mean[2]) * axis[2];
+
+            if (projection < min_projection) {
+                min_projection = projection;
+                lowest = i;
+            }
+
+            if (projection > max_projection) {
+                max_projection = projection;
+                highest = i;
+            }
+        }
+
+        auto high = colors[highest], low = colors[lowest];
+        for (auto c = 0; c < 3; c++) {
+            const auto inset = (high[c] - low[c]) / 16.0f;
+            high[c] -= inset;
+            low[c] += inset;
+        }
+
+        auto c0 = to_565(high), c1 = to_565(low);
+        if (c0 < c1)
+            std::swap(c0, c1);
+
+        uint32_t indices = 0;
+        if (c0 != c1) {
+            const auto p0 = from_565(c0), p1 = from_565(c1);
+            const std::array<color, 4> palette = {
+                p0,
+                p1,
+                color{(2 * p0[0] + p1[0]) / 3, (2 * p0[1] + p1[1]) / 3, (2 * p0[2] + p1[2]) / 3},
+                color{(p0[0] + 2 * p1[0]) / 3, (p0[1] + 2 * p1[1]) / 3, (p0[2] + 2 * p1[2]) / 3},
+            };
+
+            for (auto i = 0; i < 16; i++) {
+                auto best = 0u;
+                for (auto candidate = 1u; candidate < palette.size(); candidate++)
+                    if (distance(colors[i], palette[candidate]) < distance(colors[i], palette[best]))
+                        best = candidate;
+
+                indices |= best << (i * 2);
+            }
+        }
+
+        std::memcpy(out, &c0, sizeof(c0));
+        std::memcpy(out + 2, &c1, sizeof(c1));
+        std::memcpy(out + 4, &indices, sizeof(indices));
+    }
+
+    // bc3's alpha half, an eight value ramp between the block's extremes with 3 bit indices
+    void encode_alpha_block(std::span<const texture::pixel_rgba, 16> block, uint8_t* out) {
+        uint8_t a0 = 0, a1 = 255;
+        for (const auto& pixel : block) {
+            a0 = std::max(a0, pixel.a);
+            a1 = std::min(a1, pixel.a);
+        }
+
+        uint64_t indices = 0;
+        if (a0 != a1) {
+            std::array<int32_t, 8> palette = {a0, a1};
+            for (auto i = 1; i < 7; i++)
+                palette[i + 1] = ((7 - i) * a0 + i * a1) / 7;
+
+            for (auto i = 0; i < 16; i++) {
+                auto best = 0ull;
+                for (auto candidate = 1ull; candidate < palette.size(); candidate++)
+                    if (std::abs(block[i].a - palette[candidate]) < std::abs(block[i].a - palette[best]))
+                        best = candidate;
+
+                indices |= best << (i * 3);
+            }
+        }
+
+        out[0] = a0;
+        out[1] = a1;
+        for (auto i = 0; i < 6; i++)
+            out[2 + i] = indices >> (i * 8) & 0xff;
+    }
+
+    std::vector<uint8_t> encode(const image& source, texture::eformat format) {
+        const auto blocks_x = (source.width + 3) / 4, blocks_y = (source.height + 3) / 4;
+        std::vector<uint8_t> out(texture::level_size(format, source.width, source.height));
+
+        auto cursor = out.data();
+        for (auto by = 0; by < blocks_y; by++) {
+            for (auto bx = 0; bx < blocks_x; bx++) {
+                std::array<texture::pixel_rgba, 16> block;
+                for (auto i = 0; i < 16; i++)
+                    block[i] = source.at(bx * 4 + i % 4, by * 4 + i / 4);
+
+                if (format == texture::eformat::bc3) {
+                    encode_alpha_block(block, cursor);
+                    cursor += 8;
+                }
+
+                encode_color_block(block, cursor);
+                cursor += 8;
+            }
+        }
+
+        return out;
+    }
+
+    // the basic data format descriptor ktx2 requires, one 64 bit sample per half of the block
+    std::vector<uint8_t> data_format_descriptor(texture::eformat format) {
+        constexpr uint8_t model_bc1a = 128, model_bc3 = 130;
+        constexpr uint8_t channel_color = 0, channel_bc3_alpha = 15;
+
+        struct sample {
+            uint16_t bit_offset;
+            uint8_t channel;
+        };
+
+        std::vector<sample> samples = {{0, channel_color}};
+        if (format == texture::eformat::bc3)
+            samples = {{0, channel_bc3_alpha}, {64, channel_color}};
+
+        const auto block_size = static_cast<uint16_t>(24 + 16 * samples.size());
+
+        std::vector<uint8_t> out;
+        put<uint32_t>(out, 4 + block_size);
+        put<uint32_t>(out, 0); // khronos vendor, basic descriptor type
+        put<uint16_t>(out, 2); // version 1.3
+        put<uint16_t>(out, block_size);
+
+        put<uint8_t>(out, format == texture::eformat::bc3 ? model_bc3 : model_bc1a);
+        put<uint8_t>(out, 1); // bt709 primaries
+        put<uint8_t>(out, 1); // linear transfer, the engine samples every texture as unorm
+        put<uint8_t>(out, 0); // straight alpha
+
+        for (auto dimension : {3, 3, 0, 0})
+            put<uint8_t>(out, dimension);
+
+        put<uint8_t>(out, texture::block_size(format));
+        for (auto plane = 1; plane < 8; plane++)
+            put<uint8_t>(out, 0);
+
+        for (const auto& sample : samples) {
+            put<uint16_t>(out, sample.bit_offset);
+            put<uint8_t>(out, 63);
+            put<uint8_t>(out, sample.channel);
+            put<uint32_t>(out, 0);
+            put<uint32_t>(out, 0);
+            put<uint32_t>(out, 0xffffffff);
+        }
+
+        return out;
+    }
+
+    std::vector<uint8_t> make_ktx2(texture::eformat format, const image& base, std::span<const std::vector<uint8_t>> levels) {
+        constexpr std::array<uint8_t, 12> identifier = {0xab, 'K', 'T', 'X', ' ', '2', '0', 0xbb, '\r', '\n', 0x1a, '\n'};
+        constexpr uint32_t vk_format_bc1_rgb_unorm = 131, vk_format_bc3_unorm = 137;
+
+        const auto dfd = data_format_descriptor(format);
+        const auto dfd_offset = 80 + 24 * levels.size();
+        const auto alignment = texture::block_size(format);
+        const auto align = [&](uint64_t offset) { return (offset + alignment - 1) / alignment * alignment; };
+
+        // level data is stored smallest level first
+        std::vector<uint64_t> offsets(levels.size());
+        auto cursor = align(dfd_offset + dfd.size());
+        for (auto level = levels.size(); level-- > 0;) {
+            offsets[level] = cursor;
+            cursor = align(cursor + levels[level].size());
+        }
+
+        std::vector<uint8_t> out(identifier.begin(), identifier.end());
+        put<uint32_t>(out, format == texture::eformat::bc3 ? vk_format_bc3_unorm : vk_format_bc1_rgb_unorm);
+        put<uint32_t>(out, 1); // type size
+        put<uint32_t>(out, base.width);
+        put<uint32_t>(out, base.height);
+        put<uint32_t>(out, 0); // depth
+        put<uint32_t>(out, 0); // layers
+        put<uint32_t>(out, 1); // faces
+        put<uint32_t>(out, levels.size());
+        put<uint32_t>(out, 0); // supercompression
+
+        put<uint32_t>(out, dfd_offset);
+        put<uint32_t>(out, dfd.size());
+        put<uint32_t>(out, 0); // key/value data
+        put<uint32_t>(out, 0);
+        put<uint64_t>(out, 0); // supercompression global data
+        put<uint64_t>(out, 0);
+
+        for (auto level = 0ull; level < levels.size(); level++) {
+            put<uint64_t>(out, offsets[level]);
+            put<uint64_t>(out, levels[level].size());
+            put<uint64_t>(out, levels[level].size());
+        }
+
+        out.append_range(dfd);
+
+        for (auto level = levels.size(); level-- > 0;) {
+            out.resize(offsets[level]);
+            out.append_range(levels[level]);
+        }
+
+        return out;
+    }
+
+    bool compress(const std::filesystem::path& source) {
+        image base;
+        int32_t _;
+
+        auto raw_data = stbi_load(source.string().c_str(), &base.width, &base.height, &_, 4);
+        if (!raw_data) {
+            std::println(stderr, "failed to load '{}': {}", source.string(), stbi_failure_reason());
+            return false;
+        }
+
+        base.pixels.resize(base.width * base.height);
+        std::memcpy(base.pixels.data(), raw_data, base.pixels.size() * sizeof(texture::pixel_rgba));
+        stbi_image_free(raw_data);
+
+        const auto opaque = std::ranges::all_of(base.pixels, [](const auto& pixel) { return pixel.a == 255; });
+        const auto format = opaque ? texture::eformat::bc1 : texture::eformat::bc3;
+
+        std::vector<std::vector<uint8_t>> levels;
+        for (auto level = base;; level = downsample(level)) {
+            levels.push_back(encode(level, format));
+
+            if (level.width == 1 && level.height == 1)
+                break;
+        }
+
+        auto destination = source;
+        destination.replace_extension(".ktx2");
+
+        const auto file = make_ktx2(format, base, levels);
+
+        std::ofstream stream(destination, std::ios::binary | std::ios::trunc);
+        stream.write(reinterpret_cast<const char*>(file.data()), file.size());
+
+        if (!stream) {
+            std::println(stderr, "failed to write '{}'", destination.string());
+            return false;
+        }
+
+        std::println("'{}' -> '{}' ({}, {} levels, {} -> {} bytes)", source.string(), destination.string(),
+                     opaque ? "bc1" : "bc3", levels.size(), base.pixels.size() * sizeof(texture::pixel_rgba), file.size());
+
+        return true;
+    }
+
+    bool is_source(const std::filesystem::path& path) {
+        auto extension = path.extension().string();
+        std::ranges::transform(extension, extension.begin(), [](char c) { return std::tolower(c); });
+
+        return extension == ".png" || extension == ".jpg" || extension == ".jpeg";
+    }
+} // namespace
+
+int main(int argc, char** argv) {
+    std::vector<std::filesystem::path> inputs(argv + 1, argv + argc);
+    if (inputs.empty())
+        inputs.push_back("assets");
+
+    std::vector<std::filesystem::path> sources;
+    for (const auto& input : inputs) {
+        if (!std::filesystem::is_directory(input)) {
+            sources.push_back(input);
+            continue;
+        }
+
+        for (const auto& entry : std::filesystem::recursive_directory_iterator(input))
+            if (entry.is_regular_file() && is_source(entry.path()))
+                sources.push_back(entry.path());
+    }
+
+    auto failed = 0;
+    for (const auto& source : sources)
+        failed += !compress(source);
+
+    return failed ? 1 : 0;
+}
\ No newline at end of file